@@ -0,0 +1,87 @@
+#include "crc.h"
+#include "stdz.h"
+
+static const char* names[] = { "crc16", "crc32", "crc32c" };
+
+int crc_type(const char* name)
+{
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+        if (z_strcasecmp(name, names[i]) == 0)
+            return (int)i;
+    return -1;
+}
+
+const char* crc_name(int type)
+{
+    return names[type];
+}
+
+unsigned crc_width(int type)
+{
+    return (type == CRC16) ? 2 : 4;
+}
+
+// reflected CRC-32, slicing-by-8
+static uint32_t crc32_reflected(uint32_t poly, uint32_t table[8][256],
+    const uint8_t* data, size_t n)
+{
+    if (table[0][1] == 0) {
+        for (unsigned i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (unsigned k = 0; k < 8; ++k)
+                c = (c & 1) ? (c >> 1) ^ poly : c >> 1;
+            table[0][i] = c;
+        }
+        for (unsigned i = 0; i < 256; ++i)
+            for (unsigned k = 1; k < 8; ++k)
+                table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+    }
+
+    uint32_t crc = UINT32_MAX;
+    for (; n >= 8; n -= 8, data += 8) {
+        uint32_t lo = crc ^ (data[0] | (data[1] << 8) | (data[2] << 16)
+            | ((uint32_t)data[3] << 24));
+        uint32_t hi = data[4] | (data[5] << 8) | (data[6] << 16)
+            | ((uint32_t)data[7] << 24);
+        crc = table[7][lo & 0xff] ^ table[6][(lo >> 8) & 0xff]
+            ^ table[5][(lo >> 16) & 0xff] ^ table[4][lo >> 24]
+            ^ table[3][hi & 0xff] ^ table[2][(hi >> 8) & 0xff]
+            ^ table[1][(hi >> 16) & 0xff] ^ table[0][hi >> 24];
+    }
+    for (; n > 0; --n)
+        crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 0xff];
+    return ~crc;
+}
+
+// CRC-16/CCITT-FALSE, table driven
+static uint32_t crc16_ccitt(const uint8_t* data, size_t n)
+{
+    static uint16_t table[256];
+    if (table[1] == 0)
+        for (unsigned i = 0; i < 256; ++i) {
+            unsigned c = i << 8;
+            for (unsigned k = 0; k < 8; ++k)
+                c = (c & 0x8000) ? (c << 1) ^ 0x1021 : c << 1;
+            table[i] = (uint16_t)c;
+        }
+
+    uint16_t crc = UINT16_MAX;
+    for (; n > 0; --n)
+        crc = (uint16_t)(crc << 8) ^ table[(crc >> 8) ^ *data++];
+    return crc;
+}
+
+uint32_t crc_compute(int type, const uint8_t* data, size_t n)
+{
+    static uint32_t table32[8][256], table32c[8][256];
+
+    switch (type) {
+    case CRC16:
+        return crc16_ccitt(data, n);
+    case CRC32:
+        return crc32_reflected(0xedb88320, table32, data, n);
+    case CRC32C:
+        return crc32_reflected(0x82f63b78, table32c, data, n);
+    }
+    return 0;
+}
@@ -0,0 +1,35 @@
+#if !defined(CRC_H)
+#define CRC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// supported algorithms
+enum {
+    CRC16,      // CRC-16/CCITT-FALSE
+    CRC32,      // CRC-32 (IEEE 802.3)
+    CRC32C,     // CRC-32C (Castagnoli)
+};
+
+// find algorithm by name
+// return -1 if not found
+int crc_type(const char* name);
+
+// algorithm name
+const char* crc_name(int type);
+
+// CRC width in bytes
+unsigned crc_width(int type);
+
+// compute CRC of n bytes
+uint32_t crc_compute(int type, const uint8_t* data, size_t n);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // CRC_H
@@ -0,0 +1,265 @@
+#include "elf.h"
+#include "stdz.h"
+
+// target machines
+static const struct {
+    const char* name;
+    uint16_t machine;
+    bool is64, be;
+    uint32_t flags;
+} targets[] = {
+    { "i386", 3, false, false, 0 },
+    { "x86_64", 62, true, false, 0 },
+    { "arm", 40, false, false, 0x05000000 },    // EABI5
+    { "aarch64", 183, true, false, 0 },
+    { "riscv32", 243, false, false, 0 },        // soft-float
+    { "riscv64", 243, true, false, 0x0005 },    // RVC, double-float
+    { "ppc", 20, false, true, 0 },
+};
+
+// section indices
+enum { SHN_UNDEF, SHN_DATA, SHN_SYMTAB, SHN_STRTAB, SHN_SHSTRTAB, SHN_NOTE, SHNUM };
+
+static const char strtab[] = "\0image\0image_size\0image_base\0image_entry";
+static const char shstrtab[] = "\0.symtab\0.strtab\0.shstrtab\0.note.GNU-stack";
+
+int elf_machine(const char* name)
+{
+    if (name == NULL) {
+#if defined(__x86_64__) || defined(_M_X64)
+        name = "x86_64";
+#elif defined(__i386__) || defined(_M_IX86)
+        name = "i386";
+#elif defined(__aarch64__) || defined(_M_ARM64)
+        name = "aarch64";
+#elif defined(__arm__) || defined(_M_ARM)
+        name = "arm";
+#elif defined(__riscv) && (__riscv_xlen == 32)
+        name = "riscv32";
+#elif defined(__riscv)
+        name = "riscv64";
+#elif defined(__powerpc__) && !defined(__powerpc64__)
+        name = "ppc";
+#else
+        name = "x86_64";
+#endif
+    }
+
+    for (size_t i = 0; i < sizeof(targets) / sizeof(targets[0]); ++i)
+        if (z_strcasecmp(name, targets[i].name) == 0)
+            return (int)i;
+    return -1;
+}
+
+// read n-byte integer
+static uint64_t get(const uint8_t* ptr, unsigned n, bool be)
+{
+    uint64_t value = 0;
+    for (unsigned i = 0; i < n; ++i)
+        value |= (uint64_t)ptr[i] << (be ? (n - 1 - i) * 8 : i * 8);
+    return value;
+}
+
+// load PT_LOAD segments of ELF executable
+int elf_load(IHX* ihx, unsigned filler, size_t from, size_t to, FILE* f)
+{
+    ihx->image = NULL;
+    ihx->regions = NULL;
+    ihx->nregions = ihx->sz = ihx->base = ihx->entry = 0;
+
+    // ELF header
+    uint8_t ehdr[64];
+    if (fseek(f, 0, SEEK_SET) != 0 || fread(ehdr, 1, sizeof(ehdr), f) < 52
+        || memcmp(ehdr, "\177ELF", 4) != 0 || ehdr[4] < 1 || ehdr[4] > 2
+        || ehdr[5] < 1 || ehdr[5] > 2)
+        return 0;
+    bool is64 = (ehdr[4] == 2), be = (ehdr[5] == 2);
+    unsigned w = is64 ? 8 : 4;
+    size_t entry = get(&ehdr[24], w, be);
+    size_t phoff = get(&ehdr[24 + w], w, be);
+    unsigned phentsize = get(&ehdr[is64 ? 54 : 42], 2, be);
+    unsigned phnum = get(&ehdr[is64 ? 56 : 44], 2, be);
+    if (phentsize < (is64 ? 56u : 32u)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // program headers
+    uint8_t* phdr = (uint8_t*)z_malloc((size_t)phnum * phentsize + 1);
+    if (fseek(f, phoff, SEEK_SET) != 0
+        || fread(phdr, phentsize, phnum, f) != phnum) {
+        free(phdr);
+        errno = EINVAL;
+        return -1;
+    }
+
+    // address range of PT_LOAD segments with file data, cropped to window
+    size_t start = SIZE_MAX, end = 0;
+    for (unsigned i = 0; i < phnum; ++i) {
+        const uint8_t* ph = phdr + (size_t)i * phentsize;
+        size_t paddr = get(ph + (is64 ? 24 : 12), w, be);
+        size_t filesz = get(ph + (is64 ? 32 : 16), w, be);
+        size_t first = max(paddr, from), last = min(paddr + filesz, to);
+        if (get(ph, 4, be) == 1 && first < last) {
+            start = min(start, first);
+            end = max(end, last);
+        }
+    }
+
+    if (start < end) {
+        ihx->sz = end - start;
+        ihx->base = start;
+        ihx->entry = (start <= entry && entry < end) ? entry : start;
+        ihx->image = (uint8_t*)memset(z_malloc(ihx->sz), min(filler, 255), ihx->sz);
+
+        // read segments in place
+        for (unsigned i = 0; i < phnum; ++i) {
+            const uint8_t* ph = phdr + (size_t)i * phentsize;
+            size_t offset = get(ph + (is64 ? 8 : 4), w, be);
+            size_t paddr = get(ph + (is64 ? 24 : 12), w, be);
+            size_t filesz = get(ph + (is64 ? 32 : 16), w, be);
+            size_t first = max(paddr, from), last = min(paddr + filesz, to);
+            if (get(ph, 4, be) != 1 || first >= last)
+                continue;
+            if (fseek(f, offset + (first - paddr), SEEK_SET) != 0
+                || fread(ihx->image + first - start, 1, last - first, f) != last - first) {
+                free(phdr);
+                ihx_free(ihx);
+                errno = EINVAL;
+                return -1;
+            }
+            ihx_add_region(ihx, first, last - first);
+        }
+    }
+
+    free(phdr);
+    return 'e';
+}
+
+// write n-byte integer (n <= 8)
+static void put(uint64_t value, unsigned n, bool be, FILE* f)
+{
+    for (unsigned i = 0; i < n; ++i) {
+        unsigned shift = be ? (n - 1 - i) * 8 : i * 8;
+        fputc((uint8_t)(value >> shift), f);
+    }
+}
+
+// write n zero bytes
+static void pad(size_t n, FILE* f)
+{
+    while (n-- > 0)
+        fputc(0, f);
+}
+
+// write section header
+static void put_shdr(uint32_t name, uint32_t type, uint64_t flags, uint64_t offset,
+    uint64_t size, uint32_t link, uint32_t info, uint64_t align, uint64_t entsize,
+    unsigned w, bool be, FILE* f)
+{
+    put(name, 4, be, f);
+    put(type, 4, be, f);
+    put(flags, w, be, f);
+    put(0, w, be, f);           // sh_addr
+    put(offset, w, be, f);
+    put(size, w, be, f);
+    put(link, 4, be, f);
+    put(info, 4, be, f);
+    put(align, w, be, f);
+    put(entsize, w, be, f);
+}
+
+// write symbol table entry (GLOBAL OBJECT)
+static void put_sym(uint32_t name, uint64_t value, uint64_t size, bool is64, bool be,
+    FILE* f)
+{
+    put(name, 4, be, f);
+    if (is64) {
+        put(0x11, 1, be, f);    // st_info
+        put(0, 1, be, f);       // st_other
+        put(SHN_DATA, 2, be, f);
+        put(value, 8, be, f);
+        put(size, 8, be, f);
+    } else {
+        put(value, 4, be, f);
+        put(size, 4, be, f);
+        put(0x11, 1, be, f);
+        put(0, 1, be, f);
+        put(SHN_DATA, 2, be, f);
+    }
+}
+
+// format output as ELF relocatable object file
+void elf_dump(IHX* ihx, int machine, const char* section, FILE* f)
+{
+    bool is64 = targets[machine].is64, be = targets[machine].be;
+    unsigned w = is64 ? 8 : 4;  // word size
+    unsigned ehsize = is64 ? 64 : 52;
+    unsigned shentsize = is64 ? 64 : 40;
+    unsigned symsize = is64 ? 24 : 16;
+
+    if (section == NULL)
+        section = ".rodata";
+    size_t section_len = strlen(section) + 1;
+
+    // file layout
+    size_t data_off = ehsize;
+    size_t vars_off = (ihx->sz + w - 1) / w * w;    // image_size etc.
+    size_t data_sz = vars_off + 3 * w;
+    size_t sym_off = (data_off + data_sz + 7) / 8 * 8;
+    size_t sym_sz = 5 * symsize;
+    size_t str_off = sym_off + sym_sz;
+    size_t shstr_off = str_off + sizeof(strtab);
+    size_t shstr_sz = sizeof(shstrtab) + section_len;
+    size_t sh_off = (shstr_off + shstr_sz + 7) / 8 * 8;
+
+    // ELF header
+    fwrite("\177ELF", 1, 4, f);
+    put(is64 ? 2 : 1, 1, be, f);    // EI_CLASS
+    put(be ? 2 : 1, 1, be, f);      // EI_DATA
+    put(1, 1, be, f);               // EI_VERSION
+    pad(9, f);                      // EI_OSABI, EI_ABIVERSION, EI_PAD
+    put(1, 2, be, f);               // e_type (ET_REL)
+    put(targets[machine].machine, 2, be, f);
+    put(1, 4, be, f);               // e_version
+    put(0, w, be, f);               // e_entry
+    put(0, w, be, f);               // e_phoff
+    put(sh_off, w, be, f);
+    put(targets[machine].flags, 4, be, f);
+    put(ehsize, 2, be, f);
+    put(0, 2, be, f);               // e_phentsize
+    put(0, 2, be, f);               // e_phnum
+    put(shentsize, 2, be, f);
+    put(SHNUM, 2, be, f);
+    put(SHN_SHSTRTAB, 2, be, f);
+
+    // data section
+    if (fwrite(ihx->image, 1, ihx->sz, f) != ihx->sz)
+        z_error(EXIT_FAILURE, errno, "fwrite(%zu)", ihx->sz);
+    pad(vars_off - ihx->sz, f);
+    put(ihx->sz, w, be, f);
+    put(ihx->base, w, be, f);
+    put(ihx->entry, w, be, f);
+    pad(sym_off - data_off - data_sz, f);
+
+    // symbol table
+    pad(symsize, f);
+    put_sym(1, 0, ihx->sz, is64, be, f);                // image
+    put_sym(7, vars_off, w, is64, be, f);               // image_size
+    put_sym(18, vars_off + w, w, is64, be, f);          // image_base
+    put_sym(29, vars_off + 2 * w, w, is64, be, f);      // image_entry
+
+    // string tables
+    fwrite(strtab, 1, sizeof(strtab), f);
+    fwrite(shstrtab, 1, sizeof(shstrtab), f);
+    fwrite(section, 1, section_len, f);
+    pad(sh_off - shstr_off - shstr_sz, f);
+
+    // section headers
+    pad(shentsize, f);
+    put_shdr(sizeof(shstrtab), 1, 2, data_off, data_sz, 0, 0, w, 0, w, be, f);
+    put_shdr(1, 2, 0, sym_off, sym_sz, SHN_STRTAB, 1, w, symsize, w, be, f);
+    put_shdr(9, 3, 0, str_off, sizeof(strtab), 0, 0, 1, 0, w, be, f);
+    put_shdr(17, 3, 0, shstr_off, shstr_sz, 0, 0, 1, 0, w, be, f);
+    put_shdr(27, 1, 0, shstr_off, 0, 0, 0, 1, 0, w, be, f);
+}
@@ -0,0 +1,32 @@
+#if !defined(ELF_H)
+#define ELF_H
+
+#include "ihx.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// find target machine by name
+// if name == NULL then return host machine
+// return -1 if not found
+int elf_machine(const char* name);
+
+// load PT_LOAD segments of ELF executable by physical address
+// only data in [from, to) address window is read
+// note: may fseek(f), caller must ihx_free(ihx)
+// return 'e', or 0 if not ELF file, or -1 on error
+int elf_load(IHX* ihx, unsigned filler, size_t from, size_t to, FILE* f);
+
+// format output as ELF relocatable object file
+// defines symbols: image, image_size, image_base, image_entry
+// if section == NULL then use default value (".rodata")
+void elf_dump(IHX* ihx, int machine, const char* section, FILE* f);
+// extern const unsigned char image[];
+// extern const size_t image_size, image_base, image_entry;
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // ELF_H
@@ -1,30 +1,121 @@
 //
 // hex2c
 //
-// Convert between Intel HEX, Binary and C Include format
+// Convert between Intel HEX, S-record, Binary and C Include format
 //
 // https://github.com/matveyt/hex2c
 //
 
+#if !defined(_WIN32) && !defined(__APPLE__)
+#define _POSIX_C_SOURCE 200809L     // st_mtim
+#endif
 #include "stdz.h"
 #if defined(_WIN32)
 #include <fcntl.h>
 #include <io.h>
 #endif // _WIN32
+#include <inttypes.h>
+#include <sys/stat.h>
+#include <time.h>
+#if defined(_WIN32)
+#define ST_MTIME_NSEC(st) 0
+#elif defined(__APPLE__)
+#define ST_MTIME_NSEC(st) ((st).st_mtimespec.tv_nsec)
+#else
+#define ST_MTIME_NSEC(st) ((st).st_mtim.tv_nsec)
+#endif
+#include "crc.h"
+#include "elf.h"
 #include "ihx.h"
+#include "lz4.h"
+#include "sha256.h"
 
+static FILE* out_open(const char* fname, const char* mode, char** ptmp);
+static void out_close(FILE* f, const char* fname, char* tmp);
+static char* aux_name(const char* fname, const char* ext);
+static void c_header(IHX* ihx, FILE* f);
 static void c_dump(IHX* ihx, FILE* f);
+static void c_split_dump(IHX* ihx, FILE* f);
+static void c_regions_dump(IHX* ihx, FILE* f);
+static void c_lz4_dump(IHX* ihx, FILE* f);
+static void c_bundle_dump(IHX* ihx, size_t n, FILE* f);
+static void c_string_dump(IHX* ihx, FILE* f);
+static void embed_dump(IHX* ihx, FILE* f, bool incbin);
+static void mem_dump(IHX* ihx, int fmt, FILE* f);
+static void hexdump(IHX* ihx, FILE* f);
+static void digest_dump(IHX* ihx, FILE* f);
+static void put_digest(const uint8_t* digest, FILE* f);
+static void image_digest(IHX* ihx, size_t chunk, uint8_t (*leaf)[SHA256_SIZE],
+    uint8_t root[SHA256_SIZE]);
 
 // user options
 static struct {
     char* input;
+    char** inputs;
+    size_t ninputs;
+    char* manifest;
+    char* delta;
     char* output;
+    char* section;
     int fmt_out;
     unsigned filler;
     unsigned padding;
     unsigned wrap;
+    unsigned page;
+    unsigned split;
+    size_t split_size;
+    bool regions;
+    bool lz4;
+    unsigned word;
+    bool big_endian;
+    unsigned align;
+    int machine;
+    bool update;
+    unsigned watch;
+    int crc_type;
+    size_t range_start, range_end;
+    int overlap;
+    long long offset;
+    unsigned swap;
+    bool bitrev;
+    size_t* split_at;
+    size_t nsplit_at;
+    size_t crc_start, crc_end, crc_addr;
+    size_t digest_chunk;
+    bool digest_leaves;
 } opt = {0};
 
+// long-only options
+enum {
+    OPT_WATCH = UCHAR_MAX + 1,
+    OPT_CSTRING,
+    OPT_BUNDLE,
+    OPT_EMBED,
+    OPT_INCBIN,
+    OPT_READMEMH,
+    OPT_MIF,
+    OPT_COE,
+    OPT_DIGEST,
+    OPT_CHECK,
+    OPT_DIFF,
+    OPT_DELTA,
+    OPT_SECTION,
+    OPT_SPLIT,
+    OPT_SPLIT_SIZE,
+    OPT_SPLIT_AT,
+    OPT_OVERLAP,
+    OPT_OFFSET,
+    OPT_SWAP,
+    OPT_BITREV,
+    OPT_REGIONS,
+    OPT_LZ4,
+    OPT_PAGE,
+    OPT_CRC,
+    OPT_WORD,
+    OPT_ENDIAN,
+    OPT_ALIGN,
+};
+
 /*noreturn*/
 static void usage(int status)
 {
@@ -32,24 +123,135 @@ static void usage(int status)
         fprintf(stderr, "Try '%s --help' for more information.\n", z_getprogname());
     else
         printf(
-"Usage: %s [OPTION]... FILE\n"
-"Convert between Intel HEX, Binary and C Include format.\n"
+"Usage: %s [OPTION]... FILE...\n"
+"  or:  %s [OPTION]... --diff FILE1 FILE2\n"
+"  or:  %s [OPTION]... --check=MANIFEST\n"
+"Convert between Intel HEX, S-record, Binary and C Include format.\n"
 "\n"
 "With no FILE, or when FILE is -, write standard output.\n"
+"Several FILEs are merged into one image.\n"
 "\n"
 "-b, --binary       Binary dump output\n"
 "-c, --c            C Include output\n"
 "-x, --hex          Intel HEX format output\n"
+"-s, --srec         Motorola S-record output\n"
+"    --c-string     C Include output as string literal\n"
+"    --bundle       C Include output of all FILEs with name lookup\n"
+"    --embed        C23 #embed output (needs -o)\n"
+"    --incbin       Assembler .incbin output (needs -o)\n"
+"-e, --elf[=ARCH]   ELF relocatable object output\n"
+"-d, --dump         Canonical hex+ASCII dump output\n"
+"    --digest=SPEC  SHA-256 digest output (sha256, merkle:CHUNK[:leaves])\n"
+"    --readmemh     Verilog $readmemh output\n"
+"    --mif          Intel (Altera) MIF output\n"
+"    --coe          Xilinx COE output\n"
 "-i, --info         Only show file info\n"
+"    --diff         Show address ranges that differ between two FILEs\n"
+"    --check=MANIFEST\n"
+"                   Verify files listed in MANIFEST\n"
 "-o, --output=FILE  Set output file name\n"
+"-r, --range=START-END\n"
+"                   Only load data in address range\n"
+"    --offset=[+-]N Move image by N bytes\n"
+"    --swap=NUM     Reverse byte order in every NUM bytes (2, 4, 8)\n"
+"    --bitrev       Reverse bit order in every byte\n"
 "-z, --filler=X     Default data byte value\n"
+"    --overlap=MODE Merge overlapping FILEs (error, first, last)\n"
 "-p, --padding=NUM  Extra space on line\n"
 "-w, --wrap=NUM     Maximum output bytes per line\n"
-"-h, --help         Show this message and exit\n",
-        z_getprogname());
+"    --page=NUM     Align Intel HEX records to flash pages\n"
+"    --delta=BASE   Write only pages or records that differ from BASE file\n"
+"    --word=NUM     Bytes per C array element or memory word (1, 2, 4, 8)\n"
+"    --endian=ORDER Byte order of elements (little, big)\n"
+"    --align=NUM    Alignment of C arrays (power of two)\n"
+"    --section=NAME Set C array or ELF section name\n"
+"    --split=NUM    Split C Include output into NUM files (needs -o)\n"
+"    --split-size=N Split C Include output by N bytes (needs -o)\n"
+"    --split-at=ADDR[,ADDR]...\n"
+"                   Write one file per address range (needs -o)\n"
+"    --regions      C Include output per contiguous region\n"
+"    --lz4          C Include output compressed, with decoder\n"
+"    --crc=TYPE:START-END:ADDR\n"
+"                   Store CRC of range at ADDR (crc16, crc32, crc32c)\n"
+"-u, --update       Write output only if changed\n"
+"    --watch[=MS]   Convert again whenever FILE changes\n"
+"-h, --help         Show this message and exit\n"
+"\n"
+"MANIFEST lines are: SHA256 SIZE START-END FILE, where '-' skips a field.\n",
+        z_getprogname(), z_getprogname(), z_getprogname());
     exit(status);
 }
 
+// parse TYPE:START-END:ADDR
+static bool parse_crc(const char* spec)
+{
+    const char* colon = strchr(spec, ':');
+    if (colon == NULL)
+        return false;
+    char* type = z_strndup(spec, colon - spec);
+    opt.crc_type = crc_type(type);
+    free(type);
+
+    char* end;
+    opt.crc_start = strtoull(colon + 1, &end, 0);
+    if (*end != '-')
+        return false;
+    opt.crc_end = strtoull(end + 1, &end, 0);
+    if (*end != ':')
+        return false;
+    opt.crc_addr = strtoull(end + 1, &end, 0);
+    // CRC must not be stored inside its own range
+    return opt.crc_type >= 0 && *end == 0 && opt.crc_start <= opt.crc_end
+        && (opt.crc_addr + crc_width(opt.crc_type) <= opt.crc_start
+            || opt.crc_addr > opt.crc_end);
+}
+
+// parse START-END
+static bool parse_range(const char* spec)
+{
+    char* end;
+    opt.range_start = strtoull(spec, &end, 0);
+    if (*end != '-')
+        return false;
+    size_t last = strtoull(end + 1, &end, 0);
+    opt.range_end = (last < SIZE_MAX) ? last + 1 : SIZE_MAX;
+    return *end == 0 && opt.range_start <= last;
+}
+
+// parse ADDR[,ADDR]... in ascending order
+static bool parse_split_at(const char* spec)
+{
+    opt.nsplit_at = 0;
+    for (char* end = (char*)spec; ; spec = end + 1) {
+        size_t address = strtoull(spec, &end, 0);
+        if (end == spec || (opt.nsplit_at > 0 && address <= opt.split_at[opt.nsplit_at - 1]))
+            return false;
+        opt.split_at = (size_t*)z_realloc(opt.split_at, (opt.nsplit_at + 1) * sizeof(size_t));
+        opt.split_at[opt.nsplit_at++] = address;
+        if (*end != ',')
+            return *end == 0;
+    }
+}
+
+// parse sha256 or merkle:CHUNK[:leaves]
+static bool parse_digest(const char* spec)
+{
+    opt.digest_chunk = 0;
+    opt.digest_leaves = false;
+    if (z_strcasecmp(spec, "sha256") == 0)
+        return true;
+    if (z_strncasecmp(spec, "merkle:", 7) != 0)
+        return false;
+
+    char* end;
+    opt.digest_chunk = strtoull(spec + 7, &end, 0);
+    if (z_strcasecmp(end, ":leaves") == 0)
+        opt.digest_leaves = true;
+    else if (*end != 0)
+        return false;
+    return opt.digest_chunk > 0;
+}
+
 static void parse_args(int argc, char* argv[])
 {
     z_setprogname(argv[0]);
@@ -58,31 +260,110 @@ static void parse_args(int argc, char* argv[])
         { "binary", z_no_argument, NULL, 'b' },
         { "c", z_no_argument, NULL, 'c' },
         { "hex", z_no_argument, NULL, 'x' },
+        { "srec", z_no_argument, NULL, 's' },
+        { "c-string", z_no_argument, NULL, OPT_CSTRING },
+        { "bundle", z_no_argument, NULL, OPT_BUNDLE },
+        { "embed", z_no_argument, NULL, OPT_EMBED },
+        { "incbin", z_no_argument, NULL, OPT_INCBIN },
+        { "elf", z_optional_argument, NULL, 'e' },
+        { "dump", z_no_argument, NULL, 'd' },
+        { "digest", z_required_argument, NULL, OPT_DIGEST },
+        { "readmemh", z_no_argument, NULL, OPT_READMEMH },
+        { "mif", z_no_argument, NULL, OPT_MIF },
+        { "coe", z_no_argument, NULL, OPT_COE },
         { "info", z_no_argument, NULL, 'i' },
+        { "diff", z_no_argument, NULL, OPT_DIFF },
+        { "check", z_required_argument, NULL, OPT_CHECK },
         { "output", z_required_argument, NULL, 'o' },
+        { "range", z_required_argument, NULL, 'r' },
+        { "offset", z_required_argument, NULL, OPT_OFFSET },
+        { "swap", z_required_argument, NULL, OPT_SWAP },
+        { "bitrev", z_no_argument, NULL, OPT_BITREV },
         { "filler", z_optional_argument, NULL, 'z' },
+        { "overlap", z_required_argument, NULL, OPT_OVERLAP },
         { "padding", z_required_argument, NULL, 'p' },
         { "wrap", z_required_argument, NULL, 'w' },
+        { "page", z_required_argument, NULL, OPT_PAGE },
+        { "delta", z_required_argument, NULL, OPT_DELTA },
+        { "word", z_required_argument, NULL, OPT_WORD },
+        { "endian", z_required_argument, NULL, OPT_ENDIAN },
+        { "align", z_required_argument, NULL, OPT_ALIGN },
+        { "section", z_required_argument, NULL, OPT_SECTION },
+        { "split", z_required_argument, NULL, OPT_SPLIT },
+        { "split-size", z_required_argument, NULL, OPT_SPLIT_SIZE },
+        { "split-at", z_required_argument, NULL, OPT_SPLIT_AT },
+        { "regions", z_no_argument, NULL, OPT_REGIONS },
+        { "lz4", z_no_argument, NULL, OPT_LZ4 },
+        { "crc", z_required_argument, NULL, OPT_CRC },
+        { "update", z_no_argument, NULL, 'u' },
+        { "watch", z_optional_argument, NULL, OPT_WATCH },
         { "help", z_no_argument, NULL, 'h'},
         {0}
     };
 
     int c;
-    while ((c = z_getopt_long(argc, argv, "bcxio:z::p:w:h", lopts, NULL)) != -1) {
+    while ((c = z_getopt_long(argc, argv, "bcxse::dio:r:z::p:w:uh", lopts, NULL)) != -1) {
         switch (c) {
         case 'b':
         case 'c':
         case 'x':
+        case 's':
+        case 'd':
         case 'i':
+        case OPT_CSTRING:
+        case OPT_BUNDLE:
+        case OPT_EMBED:
+        case OPT_INCBIN:
+        case OPT_READMEMH:
+        case OPT_DIFF:
+        case OPT_MIF:
+        case OPT_COE:
+            opt.fmt_out = c;
+        break;
+        case 'e':
             opt.fmt_out = c;
+            opt.machine = elf_machine(z_optarg);
+            if (opt.machine < 0) {
+                z_warnx("unknown machine '%s'", z_optarg);
+                usage(EXIT_FAILURE);
+            }
         break;
         case 'o':
             free(opt.output);
             opt.output = z_strdup(z_optarg);
         break;
+        case 'r':
+            if (!parse_range(z_optarg)) {
+                z_warnx("invalid range '%s'", z_optarg);
+                usage(EXIT_FAILURE);
+            }
+        break;
+        case OPT_OFFSET:
+            opt.offset = strtoll(z_optarg, NULL, 0);
+        break;
+        case OPT_SWAP:
+            opt.swap = strtoul(z_optarg, NULL, 10);
+            if (opt.swap != 2 && opt.swap != 4 && opt.swap != 8) {
+                z_warnx("invalid swap size '%s'", z_optarg);
+                usage(EXIT_FAILURE);
+            }
+        break;
+        case OPT_BITREV:
+            opt.bitrev = true;
+        break;
         case 'z':
             opt.filler = z_optarg ? strtoul(z_optarg, NULL, 16) : UINT8_MAX;
         break;
+        case OPT_OVERLAP:
+            if (strcmp(z_optarg, "error") == 0)
+                opt.overlap = 0;
+            else if (strcmp(z_optarg, "first") == 0 || strcmp(z_optarg, "last") == 0)
+                opt.overlap = z_optarg[0];
+            else {
+                z_warnx("invalid overlap mode '%s'", z_optarg);
+                usage(EXIT_FAILURE);
+            }
+        break;
         case 'p':
             opt.padding = strtoul(z_optarg, NULL, 10);
             if (opt.padding > UINT8_MAX)
@@ -93,6 +374,89 @@ static void parse_args(int argc, char* argv[])
             if (opt.wrap > UINT8_MAX)
                 opt.wrap = 0;
         break;
+        case OPT_PAGE:
+            opt.page = strtoul(z_optarg, NULL, 0);
+            // power of two up to 64 KB
+            if (opt.page > 0x10000 || (opt.page & (opt.page - 1)) != 0)
+                opt.page = 0;
+        break;
+        case OPT_SECTION:
+            free(opt.section);
+            opt.section = z_strdup(z_optarg);
+        break;
+        case OPT_SPLIT:
+            opt.split = strtoul(z_optarg, NULL, 10);
+            opt.split_size = 0;
+        break;
+        case OPT_SPLIT_SIZE:
+            opt.split_size = strtoul(z_optarg, NULL, 0);
+            opt.split = opt.split_size ? 1 : 0;
+        break;
+        case OPT_SPLIT_AT:
+            if (!parse_split_at(z_optarg)) {
+                z_warnx("invalid address list '%s'", z_optarg);
+                usage(EXIT_FAILURE);
+            }
+        break;
+        case OPT_REGIONS:
+            opt.regions = true;
+        break;
+        case OPT_LZ4:
+            opt.lz4 = true;
+        break;
+        case OPT_WORD:
+            opt.word = strtoul(z_optarg, NULL, 10);
+            if (opt.word != 2 && opt.word != 4 && opt.word != 8)
+                opt.word = 1;
+        break;
+        case OPT_ENDIAN:
+            if (z_strcasecmp(z_optarg, "little") == 0 || z_strcasecmp(z_optarg, "big") == 0)
+                opt.big_endian = (z_strcasecmp(z_optarg, "big") == 0);
+            else {
+                z_warnx("invalid byte order '%s'", z_optarg);
+                usage(EXIT_FAILURE);
+            }
+        break;
+        case OPT_ALIGN:
+            // must be power of two
+            opt.align = strtoul(z_optarg, NULL, 10);
+            if (opt.align == 0 || (opt.align & (opt.align - 1)) != 0) {
+                z_warnx("invalid alignment '%s'", z_optarg);
+                usage(EXIT_FAILURE);
+            }
+        break;
+        case OPT_DIGEST:
+            // with --check only set digest parameters
+            if (opt.fmt_out != OPT_CHECK)
+                opt.fmt_out = c;
+            if (!parse_digest(z_optarg)) {
+                z_warnx("invalid digest spec '%s'", z_optarg);
+                usage(EXIT_FAILURE);
+            }
+        break;
+        case OPT_DELTA:
+            free(opt.delta);
+            opt.delta = z_strdup(z_optarg);
+        break;
+        case OPT_CHECK:
+            opt.fmt_out = c;
+            free(opt.manifest);
+            opt.manifest = z_strdup(z_optarg);
+        break;
+        case OPT_CRC:
+            if (!parse_crc(z_optarg)) {
+                z_warnx("invalid CRC spec '%s'", z_optarg);
+                usage(EXIT_FAILURE);
+            }
+        break;
+        case 'u':
+            opt.update = true;
+        break;
+        case OPT_WATCH:
+            opt.watch = z_optarg ? strtoul(z_optarg, NULL, 10) : 250;
+            if (opt.watch == 0)
+                opt.watch = 250;
+        break;
         case 'h':
             usage(EXIT_SUCCESS);
         break;
@@ -102,94 +466,1342 @@ static void parse_args(int argc, char* argv[])
         }
     }
 
-    if (z_optind == argc - 1)
+    if (z_optind < argc) {
         opt.input = z_strdup(argv[z_optind]);
-    else {
+        opt.inputs = &argv[z_optind];
+        opt.ninputs = argc - z_optind;
+    } else if (opt.fmt_out != OPT_CHECK) {
         z_warnx("missing file name");
         usage(EXIT_FAILURE);
     }
+    if ((opt.ninputs > 2 && opt.fmt_out == OPT_DIFF)
+        || (opt.ninputs > 0 && opt.fmt_out == OPT_CHECK)) {
+        z_warnx("too many file names");
+        usage(EXIT_FAILURE);
+    }
+    if (opt.delta != NULL && opt.fmt_out == OPT_CHECK) {
+        z_warnx("--delta cannot be used with --check");
+        usage(EXIT_FAILURE);
+    }
+    if (opt.delta != NULL && opt.fmt_out != 'x' && opt.fmt_out != 's') {
+        z_warnx("--delta needs Intel HEX or S-record output");
+        usage(EXIT_FAILURE);
+    }
+    if (opt.ninputs < 2 && opt.fmt_out == OPT_DIFF) {
+        z_warnx("missing file name");
+        usage(EXIT_FAILURE);
+    }
+    if ((opt.fmt_out == OPT_EMBED || opt.fmt_out == OPT_INCBIN) && opt.word > 1) {
+        z_warnx("--word cannot be used with --embed or --incbin");
+        usage(EXIT_FAILURE);
+    }
+    if ((opt.fmt_out == OPT_EMBED || opt.fmt_out == OPT_INCBIN || opt.split > 0
+        || opt.nsplit_at > 0)
+        && (opt.output == NULL || strcmp(opt.output, "-") == 0)) {
+        z_warnx("missing output file name");
+        usage(EXIT_FAILURE);
+    }
+    if (opt.watch > 0 && opt.fmt_out == OPT_CHECK) {
+        z_warnx("--watch cannot be used with --check");
+        usage(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < opt.ninputs; ++i)
+        if ((opt.watch > 0 || opt.ninputs > 1) && strcmp(opt.inputs[i], "-") == 0) {
+            z_warnx("cannot use standard input");
+            usage(EXIT_FAILURE);
+        }
 }
 
-int main(int argc, char* argv[])
+// move image to another address, no data is copied
+// return false if out of address space
+static bool relocate(IHX* ihx, long long offset)
 {
-    opt.filler = UINT8_MAX + 1; // not used
-    parse_args(argc, argv);
+    size_t delta = (size_t)(offset < 0 ? -offset : offset);
+    if (offset < 0 ? (ihx->base < delta) : (ihx->base + ihx->sz > SIZE_MAX - delta)) {
+        errno = ERANGE;
+        return false;
+    }
+
+    if (offset < 0)
+        delta = -delta;
+    ihx->base += delta;
+    ihx->entry += delta;
+    for (size_t i = 0; i < ihx->nregions; ++i)
+        ihx->regions[i].address += delta;
+    return true;
+}
 
-    // open files
-    FILE* fin = z_fopen(opt.input, "rb");
-    FILE* fout = z_fopen(opt.output, "w");
+// reverse byte order in every n bytes aligned by address
+// partial words at both ends are padded with filler
+static void swap_bytes(IHX* ihx, unsigned n)
+{
+    size_t head = ihx->base % n;
+    size_t sz = (head + ihx->sz + n - 1) / n * n;
+    if (sz > ihx->sz) {
+        uint8_t* image = (uint8_t*)memset(z_malloc(sz), min(opt.filler, UINT8_MAX), sz);
+        memcpy(image + head, ihx->image, ihx->sz);
+        free(ihx->image);
+        ihx->image = image;
+        ihx->base -= head;
+        ihx->sz = sz;
+    }
 
-    // read in
-    IHX ihx;
-    int fmt_in = ihx_load(&ihx, opt.filler, fin);
+    // whole words become loaded data, so padding is never dropped
+    size_t nregions = ihx->nregions;
+    IHX_REGION* regions = (IHX_REGION*)z_malloc(nregions * sizeof(IHX_REGION));
+    if (nregions > 0)
+        memcpy(regions, ihx->regions, nregions * sizeof(IHX_REGION));
+    for (size_t i = 0; i < nregions; ++i) {
+        size_t first = regions[i].address / n * n;
+        size_t last = (regions[i].address + regions[i].sz + n - 1) / n * n;
+        ihx_add_region(ihx, first, last - first);
+    }
+    free(regions);
+
+    for (uint8_t* p = ihx->image; p < ihx->image + sz; p += n)
+        for (unsigned i = 0; i < n / 2; ++i) {
+            uint8_t t = p[i];
+            p[i] = p[n - 1 - i];
+            p[n - 1 - i] = t;
+        }
+}
+
+// reverse bit order in every byte
+static void reverse_bits(IHX* ihx)
+{
+    for (size_t i = 0; i < ihx->sz; ++i) {
+        uint8_t b = ihx->image[i];
+        b = (b & 0xf0) >> 4 | (b & 0x0f) << 4;
+        b = (b & 0xcc) >> 2 | (b & 0x33) << 2;
+        b = (b & 0xaa) >> 1 | (b & 0x55) << 1;
+        ihx->image[i] = b;
+    }
+}
+
+// compute CRC over range and store it into image
+// return false if out of image
+static bool patch_crc(IHX* ihx, uint32_t* crc)
+{
+    unsigned width = crc_width(opt.crc_type);
+    size_t end = ihx->base + ihx->sz;
+    if (opt.crc_start < ihx->base || opt.crc_end >= end || opt.crc_addr < ihx->base
+        || opt.crc_addr + width > end) {
+        errno = ERANGE;
+        return false;
+    }
+
+    *crc = crc_compute(opt.crc_type, ihx->image + opt.crc_start - ihx->base,
+        opt.crc_end - opt.crc_start + 1);
+    uint8_t* ptr = ihx->image + opt.crc_addr - ihx->base;
+    for (unsigned k = 0; k < width; ++k)
+        ptr[k] = (uint8_t)(*crc >> 8 * (opt.big_endian ? width - 1 - k : k));
+    // CRC may land in a gap
+    ihx_add_region(ihx, opt.crc_addr, width);
+    return true;
+}
+
+// load input file
+// return input format or -1 on error
+static int load(IHX* ihx, const char* fname)
+{
+    // in watch mode file may vanish between polls
+    FILE* fin = opt.watch ? fopen(fname, "rb") : z_fopen(fname, "rb");
+    if (fin == NULL) {
+        z_error(0, errno, "fopen(%s)", fname);
+        return -1;
+    }
+    int fmt_in = ihx_load_range(ihx, opt.filler, opt.range_start, opt.range_end, fin);
+    fclose(fin);
     if (fmt_in < 0)
-        z_error(EXIT_FAILURE, errno, "ihx_load");
+        z_error(opt.watch ? 0 : EXIT_FAILURE, errno, "ihx_load(%s)", fname);
+    return fmt_in;
+}
 
-    // write out
+// write image in selected output format
+static void write_out(IHX* ihx, int fmt_in, const IHX* ref, uint32_t crc, FILE* fout)
+{
     switch (opt.fmt_out) {
     case 'b':
 #if defined(_WIN32)
         _setmode(_fileno(fout), _O_BINARY);
 #endif
         if (opt.filler <= UINT8_MAX)
-            for (size_t i = ihx.base; i > 0; --i)
+            for (size_t i = ihx->base; i > 0; --i)
                 fputc(opt.filler, fout);
-        if (fwrite(ihx.image, 1, ihx.sz, fout) != ihx.sz)
-            z_error(EXIT_FAILURE, errno, "fwrite(%zu)", ihx.sz);
+        if (fwrite(ihx->image, 1, ihx->sz, fout) != ihx->sz)
+            z_error(EXIT_FAILURE, errno, "fwrite(%zu)", ihx->sz);
     break;
     case 'c':
     case 0:
-        c_dump(&ihx, fout);
+        if (opt.lz4)
+            c_lz4_dump(ihx, fout);
+        else if (opt.regions)
+            c_regions_dump(ihx, fout);
+        else if (opt.split > 0)
+            c_split_dump(ihx, fout);
+        else
+            c_dump(ihx, fout);
+    break;
+    case OPT_CSTRING:
+        c_string_dump(ihx, fout);
     break;
     case 'x':
-        ihx_dump(&ihx, opt.filler, opt.wrap, fout);
+        ihx_dump(ihx, ref, opt.filler, opt.wrap, opt.page, fout);
+    break;
+    case 's':
+        srec_dump(ihx, ref, opt.filler, opt.wrap, opt.page, fout);
+    break;
+    case OPT_EMBED:
+    case OPT_INCBIN:
+        embed_dump(ihx, fout, opt.fmt_out == OPT_INCBIN);
+    break;
+    case OPT_READMEMH:
+    case OPT_MIF:
+    case OPT_COE:
+        mem_dump(ihx, opt.fmt_out, fout);
+    break;
+    case 'd':
+        hexdump(ihx, fout);
+    break;
+    case OPT_DIGEST:
+        digest_dump(ihx, fout);
+    break;
+    case 'e':
+#if defined(_WIN32)
+        _setmode(_fileno(fout), _O_BINARY);
+#endif
+        elf_dump(ihx, opt.machine, opt.section, fout);
     break;
     case 'i':
-        printf("Format: %s\n", (fmt_in == 'x') ? "Intel HEX" : "Binary");
-        printf("Size: %zu bytes\n", ihx.sz);
-        if (fmt_in == 'x' && ihx.sz > 0) {
-            printf("Address Range: %04zX-%04zX\n", ihx.base, ihx.base + ihx.sz - 1);
-            printf("Entry Point: %04zX\n", ihx.entry);
+        printf("Format: %s\n", (fmt_in == 'x') ? "Intel HEX" :
+            (fmt_in == 's') ? "Motorola S-record" : (fmt_in == 'e') ? "ELF" : "Binary");
+        printf("Size: %zu bytes\n", ihx->sz);
+        if (fmt_in != 'b' && ihx->sz > 0) {
+            printf("Address Range: %04zX-%04zX\n", ihx->base, ihx->base + ihx->sz - 1);
+            printf("Entry Point: %04zX\n", ihx->entry);
         }
+        if (opt.crc_type >= 0)
+            printf("Checksum (%s): %0*" PRIX32 "\n", crc_name(opt.crc_type),
+                2 * crc_width(opt.crc_type), crc);
     break;
     }
+}
 
-    free(ihx.image);
-    fclose(fout);
-    fclose(fin);
+// make view of image in [from, to) address range
+// image data is shared, caller must free(part->regions)
+static void slice(IHX* ihx, size_t from, size_t to, IHX* part)
+{
+    size_t top = ihx->base + ihx->sz;
+    size_t lo = min(max(from, ihx->base), top);
+    size_t hi = max(min(to, top), lo);
+
+    part->image = ihx->image + (lo - ihx->base);
+    part->sz = hi - lo;
+    part->base = lo;
+    part->entry = (lo <= ihx->entry && ihx->entry < hi) ? ihx->entry : lo;
+    part->regions = NULL;
+    part->nregions = 0;
+    for (size_t i = 0; i < ihx->nregions; ++i) {
+        size_t first = max(ihx->regions[i].address, lo);
+        size_t last = min(ihx->regions[i].address + ihx->regions[i].sz, hi);
+        if (first < last)
+            ihx_add_region(part, first, last - first);
+    }
+}
+
+// write one output file per address range
+// FILE.ext is written as FILE_0.ext, FILE_1.ext, etc.
+static void split_at(IHX* ihx, int fmt_in, const IHX* ref, uint32_t crc)
+{
+    char* output = opt.output;
+    const char* dot = strrchr(z_basename(output), '.');
+
+    for (size_t k = 0; k <= opt.nsplit_at; ++k) {
+        IHX part;
+        slice(ihx, k ? opt.split_at[k - 1] : 0,
+            (k < opt.nsplit_at) ? opt.split_at[k] : SIZE_MAX, &part);
+
+        // emitters may derive more file names from output name
+        char *ext, *tmp;
+        z_asprintf(&ext, "_%zu%s", k, dot ? dot : "");
+        opt.output = aux_name(output, ext);
+        FILE* fout = out_open(opt.output, "w", &tmp);
+        write_out(&part, fmt_in, ref, crc, fout);
+        out_close(fout, opt.output, tmp);
+
+        free(opt.output);
+        free(ext);
+        free(part.regions);
+    }
+
+    opt.output = output;
+}
+
+// convert input file
+// return false on error
+static bool convert(void)
+{
+    // read in
+    IHX ihx;
+    int fmt_in = load(&ihx, opt.input);
+    if (fmt_in < 0)
+        return false;
+
+    // merge other input files
+    for (size_t n = 1; n < opt.ninputs; ++n) {
+        IHX more;
+        if (load(&more, opt.inputs[n]) < 0) {
+            ihx_free(&ihx);
+            return false;
+        }
+        bool overlap = ihx_overlap(&ihx, &more);
+        if (overlap && opt.overlap == 0) {
+            z_error(opt.watch ? 0 : EXIT_FAILURE, 0, "%s: overlaps previous input",
+                opt.inputs[n]);
+            ihx_free(&more);
+            ihx_free(&ihx);
+            return false;
+        }
+        ihx_merge(&ihx, &more, opt.filler, opt.overlap == 'l');
+        ihx_free(&more);
+    }
+
+    // transform image
+    if (opt.offset != 0 && !relocate(&ihx, opt.offset)) {
+        z_error(opt.watch ? 0 : EXIT_FAILURE, errno, "--offset");
+        ihx_free(&ihx);
+        return false;
+    }
+    if (opt.swap > 0)
+        swap_bytes(&ihx, opt.swap);
+    if (opt.bitrev)
+        reverse_bits(&ihx);
+    uint32_t crc = 0;
+    if (opt.crc_type >= 0 && !patch_crc(&ihx, &crc)) {
+        z_error(opt.watch ? 0 : EXIT_FAILURE, errno, "--crc");
+        ihx_free(&ihx);
+        return false;
+    }
+
+    // Intel HEX and S-record cannot address above 4 GB
+    if ((opt.fmt_out == 'x' || opt.fmt_out == 's')
+        && (uint64_t)ihx.base + ihx.sz > UINT64_C(0x100000000)) {
+        z_error(opt.watch ? 0 : EXIT_FAILURE, ERANGE, "%s", opt.input);
+        ihx_free(&ihx);
+        return false;
+    }
+
+    // reference image
+    IHX ref;
+    if (opt.delta != NULL && load(&ref, opt.delta) < 0) {
+        ihx_free(&ihx);
+        return false;
+    }
+
+    // write out, or one file per address range
+    if (opt.nsplit_at > 0)
+        split_at(&ihx, fmt_in, opt.delta ? &ref : NULL, crc);
+    else {
+        char* tmp;
+        FILE* fout = out_open(opt.output, "w", &tmp);
+        write_out(&ihx, fmt_in, opt.delta ? &ref : NULL, crc, fout);
+        out_close(fout, opt.output, tmp);
+    }
+
+    if (opt.delta != NULL)
+        ihx_free(&ref);
+    ihx_free(&ihx);
+    return true;
+}
+
+// load all input files into bundle
+// return false on error
+static bool bundle(void)
+{
+    IHX* ihx = (IHX*)z_malloc(opt.ninputs * sizeof(IHX));
+    size_t n;
+    for (n = 0; n < opt.ninputs; ++n)
+        if (load(&ihx[n], opt.inputs[n]) < 0)
+            break;
+
+    bool ok = (n == opt.ninputs);
+    if (ok) {
+        char* tmp;
+        FILE* fout = out_open(opt.output, "w", &tmp);
+        c_bundle_dump(ihx, n, fout);
+        out_close(fout, opt.output, tmp);
+    }
+
+    while (n > 0)
+        ihx_free(&ihx[--n]);
+    free(ihx);
+    return ok;
+}
+
+// report one manifest mismatch
+static void mismatch(FILE* f, const char* fname, const char* field, const char* expected,
+    const char* actual)
+{
+    fprintf(f, "%s\t%s\t%s\t%s\n", fname, field, expected, actual);
+}
+
+// verify files against manifest
+// write tab separated line per mismatch, or FILE OK
+// return false if any mismatch
+static bool check(void)
+{
+    FILE* fman = z_fopen(opt.manifest, "r");
+    char* tmp;
+    FILE* fout = out_open(opt.output, "w", &tmp);
+
+    bool ok = true;
+    char* line = NULL;
+    size_t n = 0;
+    while (z_getline(&line, &n, fman) > 0) {
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[0] == 0 || line[0] == '#')
+            continue;
+
+        // SHA256 SIZE START-END FILE
+        char digest[2 * SHA256_SIZE + 1], size[32], range[64];
+        int pos = 0;
+        if (sscanf(line, "%64s %31s %63s %n", digest, size, range, &pos) != 3
+            || line[pos] == 0) {
+            mismatch(fout, line, "syntax", "-", "-");
+            ok = false;
+            continue;
+        }
+        const char* fname = line + pos;
+
+        FILE* fin = fopen(fname, "rb");
+        if (fin == NULL) {
+            mismatch(fout, fname, "file", "-", strerror(errno));
+            ok = false;
+            continue;
+        }
+        IHX ihx;
+        int fmt_in = ihx_load_range(&ihx, opt.filler, opt.range_start, opt.range_end,
+            fin);
+        fclose(fin);
+        if (fmt_in < 0) {
+            mismatch(fout, fname, "file", "-", strerror(errno));
+            ok = false;
+            continue;
+        }
+
+        bool same = true;
+        char actual[2 * SHA256_SIZE + 1];
+        if (strcmp(size, "-") != 0 && strtoull(size, NULL, 10) != ihx.sz) {
+            snprintf(actual, sizeof(actual), "%zu", ihx.sz);
+            mismatch(fout, fname, "size", size, actual);
+            same = false;
+        }
+        if (strcmp(range, "-") != 0) {
+            char* end;
+            size_t start = strtoull(range, &end, 16);
+            size_t last = (*end == '-') ? strtoull(end + 1, NULL, 16) : 0;
+            if (ihx.sz == 0 || start != ihx.base || last != ihx.base + ihx.sz - 1) {
+                snprintf(actual, sizeof(actual), "%04zX-%04zX", ihx.base,
+                    ihx.base + ihx.sz - 1);
+                mismatch(fout, fname, "range", range, actual);
+                same = false;
+            }
+        }
+        if (strcmp(digest, "-") != 0) {
+            uint8_t root[SHA256_SIZE];
+            image_digest(&ihx, opt.digest_chunk, NULL, root);
+            for (unsigned i = 0; i < SHA256_SIZE; ++i)
+                snprintf(&actual[2 * i], 3, "%02x", root[i]);
+            if (z_strcasecmp(digest, actual) != 0) {
+                mismatch(fout, fname, "digest", digest, actual);
+                same = false;
+            }
+        }
+        if (same)
+            fprintf(fout, "%s\tOK\n", fname);
+
+        ok = ok && same;
+        ihx_free(&ihx);
+    }
+
+    free(line);
+    out_close(fout, opt.output, tmp);
+    fclose(fman);
+    return ok;
+}
+
+// write address range of length sz, skip empty range
+static void put_range(size_t address, size_t sz, const char* what, FILE* f)
+{
+    if (sz == 0)
+        return;
+    fprintf(f, "%04zX-%04zX: %zu bytes %s\n", address, address + sz - 1, sz, what);
+}
+
+// find length of equal (or different) run of bytes
+// compare by blocks first as differences are usually sparse
+static size_t same_run(const uint8_t* a, const uint8_t* b, size_t sz, bool same)
+{
+    enum { BLOCK = 64 };
+    size_t i = 0;
+    if (same)
+        while (i + BLOCK <= sz && memcmp(a + i, b + i, BLOCK) == 0)
+            i += BLOCK;
+    while (i < sz && (a[i] == b[i]) == same)
+        ++i;
+    return i;
+}
+
+// compare two input files
+// write differing address ranges, return false if any
+static bool diff(void)
+{
+    IHX ihx[2];
+    for (size_t n = 0; n < 2; ++n)
+        if (load(&ihx[n], opt.inputs[n]) < 0) {
+            if (n > 0)
+                ihx_free(&ihx[0]);
+            return false;
+        }
+
+    char* tmp;
+    FILE* fout = out_open(opt.output, "w", &tmp);
+
+    bool same = true;
+    if (ihx[0].base != ihx[1].base) {
+        fprintf(fout, "Base: %04zX %04zX\n", ihx[0].base, ihx[1].base);
+        same = false;
+    }
+    if (ihx[0].sz != ihx[1].sz) {
+        fprintf(fout, "Size: %zu %zu\n", ihx[0].sz, ihx[1].sz);
+        same = false;
+    }
+    if (ihx[0].entry != ihx[1].entry) {
+        fprintf(fout, "Entry Point: %04zX %04zX\n", ihx[0].entry, ihx[1].entry);
+        same = false;
+    }
+
+    // address space of each file, and their overlap
+    size_t lo[2] = { ihx[0].base, ihx[1].base };
+    size_t hi[2] = { ihx[0].base + ihx[0].sz, ihx[1].base + ihx[1].sz };
+    size_t start = max(lo[0], lo[1]);
+    size_t end = max(min(hi[0], hi[1]), start);
+
+    // head and tail outside overlap
+    size_t total = 0;
+    for (size_t n = 0; n < 2; ++n)
+        if (lo[n] < start) {
+            put_range(lo[n], min(start, hi[n]) - lo[n], n ? "only in FILE2" : "only in FILE1",
+                fout);
+            total += min(start, hi[n]) - lo[n];
+        }
+    const uint8_t* a = ihx[0].image + (start - lo[0]);
+    const uint8_t* b = ihx[1].image + (start - lo[1]);
+    for (size_t i = 0; i < end - start; ) {
+        i += same_run(a + i, b + i, end - start - i, true);
+        size_t sz = same_run(a + i, b + i, end - start - i, false);
+        if (sz > 0) {
+            put_range(start + i, sz, "differ", fout);
+            total += sz;
+            i += sz;
+        }
+    }
+    for (size_t n = 0; n < 2; ++n)
+        if (hi[n] > end) {
+            size_t from = max(end, lo[n]);
+            put_range(from, hi[n] - from, n ? "only in FILE2" : "only in FILE1", fout);
+            total += hi[n] - from;
+        }
+
+    if (total > 0) {
+        fprintf(fout, "Total: %zu bytes\n", total);
+        same = false;
+    }
+
+    ihx_free(&ihx[1]);
+    ihx_free(&ihx[0]);
+    out_close(fout, opt.output, tmp);
+    return same;
+}
+
+// convert, bundle, compare or check input files
+static bool run(void)
+{
+    switch (opt.fmt_out) {
+    case OPT_BUNDLE:
+        return bundle();
+    case OPT_DIFF:
+        return diff();
+    case OPT_CHECK:
+        return check();
+    default:
+        return convert();
+    }
+}
+
+// modification stamp of all input files
+// hash of time (with nanoseconds), size and inode, or 0 if any is missing
+typedef uint64_t STAMP;
+
+static STAMP mix_stamp(STAMP stamp, uint64_t value)
+{
+    return (stamp ^ value) * UINT64_C(0x100000001b3);   // FNV-1a
+}
+
+static STAMP get_stamp(void)
+{
+    STAMP stamp = UINT64_C(0xcbf29ce484222325);
+    for (size_t i = 0; i < opt.ninputs; ++i) {
+        struct stat st;
+        if (stat(opt.inputs[i], &st) != 0)
+            return 0;
+        stamp = mix_stamp(stamp, (uint64_t)st.st_mtime);
+        stamp = mix_stamp(stamp, (uint64_t)ST_MTIME_NSEC(st));
+        stamp = mix_stamp(stamp, (uint64_t)st.st_size);
+        stamp = mix_stamp(stamp, (uint64_t)st.st_ino);
+    }
+    return stamp;
+}
+
+// poll input files and convert on every change
+/*noreturn*/
+static void watch(void)
+{
+    STAMP last = get_stamp();
+    run();
+
+    for (;;) {
+        z_delay(opt.watch);
+        STAMP now = get_stamp();
+        if (now == last)
+            continue;
+
+        // debounce: wait until file stays unchanged for one period
+        do {
+            last = now;
+            z_delay(opt.watch);
+            now = get_stamp();
+        } while (now != last);
+
+        // file may be gone again (e.g. rename on save), then retry on next change
+        if (now != 0)
+            run();
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    opt.filler = UINT8_MAX + 1; // not used
+    opt.word = 1;
+    opt.crc_type = -1;
+    opt.range_end = SIZE_MAX;
+    parse_args(argc, argv);
+
+    if (opt.watch > 0)
+        watch();
+    bool ok = run();
+
+    free(opt.split_at);
+    free(opt.delta);
+    free(opt.manifest);
+    free(opt.section);
     free(opt.output);
     free(opt.input);
-    exit(EXIT_SUCCESS);
+    exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
 }
 
-// write C Include output file
-void c_dump(IHX* ihx, FILE* f)
+// open output file
+// in update mode, write to temporary file instead
+static FILE* out_open(const char* fname, const char* mode, char** ptmp)
 {
-    // user options
-    unsigned wrap = opt.wrap ? opt.wrap : 8;
-    unsigned padding = opt.padding ? opt.padding : 4;
+    *ptmp = NULL;
+    if (opt.update && fname != NULL && strcmp(fname, "-") != 0)
+        z_asprintf(ptmp, "%s.tmp", fname);
+    return z_fopen(*ptmp ? *ptmp : fname, mode);
+}
 
-    // header
+// compare two files chunk by chunk
+static bool same_content(const char* fname1, const char* fname2)
+{
+    FILE* f1 = fopen(fname1, "rb");
+    if (f1 == NULL)
+        return false;
+    FILE* f2 = z_fopen(fname2, "rb");
+
+    static char buf1[0x10000], buf2[0x10000];
+    bool same;
+    size_t n1, n2;
+    do {
+        n1 = fread(buf1, 1, sizeof(buf1), f1);
+        n2 = fread(buf2, 1, sizeof(buf2), f2);
+        same = (n1 == n2 && memcmp(buf1, buf2, n1) == 0);
+    } while (same && n1 == sizeof(buf1));
+
+    fclose(f2);
+    fclose(f1);
+    return same;
+}
+
+// close output file
+// in update mode, replace target file only if content differs
+static void out_close(FILE* f, const char* fname, char* tmp)
+{
+    if (((f == stdout) ? fflush(f) : fclose(f)) != 0)
+        z_error(EXIT_FAILURE, errno, "fclose(%s)", tmp ? tmp : fname);
+    if (tmp == NULL)
+        return;
+
+    if (same_content(fname, tmp))
+        remove(tmp);
+    else {
+#if defined(_WIN32)
+        remove(fname);  // rename(3) won't overwrite on Windows
+#endif
+        if (rename(tmp, fname) != 0)
+            z_error(EXIT_FAILURE, errno, "rename(%s, %s)", tmp, fname);
+    }
+    free(tmp);
+}
+
+// make file name with different extension
+static char* aux_name(const char* fname, const char* ext)
+{
+    const char* dot = strrchr(z_basename(fname), '.');
+    size_t n = dot ? (size_t)(dot - fname) : strlen(fname);
+    char* aux;
+    z_asprintf(&aux, "%.*s%s", (int)n, fname, ext);
+    if (strcmp(aux, fname) == 0) {
+        free(aux);
+        z_asprintf(&aux, "%s%s", fname, ext);
+    }
+    return aux;
+}
+
+// C element type
+static const char* c_type(unsigned word)
+{
+    switch (word) {
+    case 2: return "uint16_t";
+    case 4: return "uint32_t";
+    case 8: return "uint64_t";
+    default: return "unsigned char";
+    }
+}
+
+// number of elements for sz bytes
+static size_t c_count(size_t sz, unsigned word)
+{
+    return (sz + word - 1) / word;
+}
+
+// write comment lines about image
+// also valid in preprocessed assembler source
+static void comment_header(IHX* ihx, FILE* f)
+{
     fprintf(f, "// made with %s\n", z_getprogname());
     if (ihx->base > 0)
         fprintf(f, "// image base %#04zx\n", ihx->base);
     if (ihx->entry > 0)
         fprintf(f, "// entry point %#04zx\n", ihx->entry);
-    fprintf(f, "const unsigned char image[%zu] = {\n", ihx->sz);
+}
 
-    for (size_t i = 0; i < ihx->sz; i += wrap) {
+// write comment header and includes of C output
+void c_header(IHX* ihx, FILE* f)
+{
+    comment_header(ihx, f);
+    if (opt.word > 1)
+        fputs("#include <stdint.h>\n", f);
+}
+
+// write array declarator with optional attributes
+static void c_decl(const char* type, const char* name, size_t count, FILE* f)
+{
+    fprintf(f, "const %s %s[%zu]", type, name, count);
+    if (opt.align > 0 && opt.section != NULL)
+        fprintf(f, " __attribute__((aligned(%u), section(\"%s\")))", opt.align,
+            opt.section);
+    else if (opt.align > 0)
+        fprintf(f, " __attribute__((aligned(%u)))", opt.align);
+    else if (opt.section != NULL)
+        fprintf(f, " __attribute__((section(\"%s\")))", opt.section);
+}
+
+// assemble word at data[i], pad it with filler if past end
+static uint64_t get_word(const uint8_t* data, size_t sz, size_t i, unsigned word)
+{
+    unsigned filler = (opt.filler <= UINT8_MAX) ? opt.filler : 0;
+    uint64_t value = 0;
+    for (unsigned k = 0; k < word; ++k) {
+        uint64_t c = (i + k < sz) ? data[i + k] : filler;
+        value |= c << 8 * (opt.big_endian ? word - 1 - k : k);
+    }
+    return value;
+}
+
+// write C array definition
+static void c_array(const char* name, const uint8_t* data, size_t sz, size_t address,
+    unsigned word, FILE* f)
+{
+    // user options
+    unsigned wrap = opt.wrap ? max(opt.wrap / word, 1) : (word > 1) ? 16 / word : 8;
+    unsigned padding = opt.padding ? opt.padding : 4;
+    unsigned width = (word > 1) ? 2 * word + 4 : 6;  // "0x12345678, "
+
+    c_decl(c_type(word), name, c_count(sz, word), f);
+    fputs(" = {\n", f);
+
+    for (size_t i = 0; i < sz; i += wrap * word) {
         // leading space
         fprintf(f, "%*c", padding, ' ');
 
         // data
-        unsigned cb = min(wrap, ihx->sz - i);
-        for (unsigned j = 0; j < cb; ++j)
-            fprintf(f, "%#02x, ", ihx->image[i + j]);
+        unsigned cb = min(wrap, c_count(sz - i, word));
+        for (unsigned j = 0; j < cb; ++j) {
+            if (word == 1) {
+                fprintf(f, "%#02x, ", data[i + j]);
+                continue;
+            }
+            uint64_t value = get_word(data, sz, i + j * word, word);
+            fprintf(f, "0x%0*llx, ", 2 * word, (unsigned long long)value);
+        }
 
         // trailing space
-        fprintf(f, "%*c// %03zx\n", (wrap - cb) * 6 - 1 + padding, ' ', ihx->base + i);
+        fprintf(f, "%*c// %03zx\n", (wrap - cb) * width - 1 + padding, ' ', address + i);
     }
 
     // footer
     fputs("};\n", f);
 }
+
+// write C Include output file
+void c_dump(IHX* ihx, FILE* f)
+{
+    c_header(ihx, f);
+    c_array("image", ihx->image, ihx->sz, ihx->base, opt.word, f);
+}
+
+// write C Include output split into several files
+// header gets declarations and accessor table
+void c_split_dump(IHX* ihx, FILE* f)
+{
+    size_t part_sz = opt.split_size;
+    if (part_sz == 0)
+        part_sz = (ihx->sz + opt.split - 1) / opt.split;
+    part_sz = c_count(part_sz, opt.word) * opt.word;
+    size_t parts = (part_sz > 0) ? (ihx->sz + part_sz - 1) / part_sz : 0;
+
+    // header
+    c_header(ihx, f);
+    fprintf(f, "// image split into %zu parts\n", parts);
+    fprintf(f, "#define IMAGE_SIZE %zuu\n", ihx->sz);
+    fprintf(f, "#define IMAGE_PART_SIZE %zuu\n", part_sz);
+    for (size_t n = 0; n < parts; ++n)
+        fprintf(f, "extern const %s image_%zu[%zu];\n", c_type(opt.word), n,
+            c_count(min(part_sz, ihx->sz - n * part_sz), opt.word));
+    fprintf(f, "static const %s* const image_parts[] = {\n", c_type(opt.word));
+    for (size_t n = 0; n < parts; ++n)
+        fprintf(f, "    image_%zu,\n", n);
+    fputs("};\n", f);
+    size_t count = c_count(part_sz, opt.word);
+    fprintf(f, "#define image_at(i) (image_parts[(i) / %zu][(i) %% %zu])\n", count,
+        count);
+
+    // parts
+    for (size_t n = 0; n < parts; ++n) {
+        char *ext, *part_name, *name, *tmp;
+        z_asprintf(&ext, "_%zu.c", n);
+        part_name = aux_name(opt.output, ext);
+        z_asprintf(&name, "image_%zu", n);
+
+        FILE* fpart = out_open(part_name, "w", &tmp);
+        fprintf(fpart, "// made with %s\n", z_getprogname());
+        fprintf(fpart, "// part %zu of %zu\n", n + 1, parts);
+        if (opt.word > 1)
+            fputs("#include <stdint.h>\n", fpart);
+        size_t offset = n * part_sz;
+        c_array(name, ihx->image + offset, min(part_sz, ihx->sz - offset),
+            ihx->base + offset, opt.word, fpart);
+        out_close(fpart, part_name, tmp);
+
+        free(name);
+        free(part_name);
+        free(ext);
+    }
+}
+
+// write C Include output with one array per region
+// gaps between regions are not filled
+void c_regions_dump(IHX* ihx, FILE* f)
+{
+    c_header(ihx, f);
+    for (size_t n = 0; n < ihx->nregions; ++n) {
+        char* name;
+        z_asprintf(&name, "image_%zu", n);
+        IHX_REGION* r = &ihx->regions[n];
+        c_array(name, ihx->image + r->address - ihx->base, r->sz, r->address,
+            opt.word, f);
+        free(name);
+    }
+
+    // region table
+    fprintf(f, "#define IMAGE_REGIONS %zuu\n", ihx->nregions);
+    fprintf(f, "const struct {\n"
+               "    unsigned long address, size;\n"
+               "    const %s* data;\n"
+               "} image_regions[IMAGE_REGIONS] = {\n", c_type(opt.word));
+    for (size_t n = 0; n < ihx->nregions; ++n)
+        fprintf(f, "    { %#zx, %zu, image_%zu },\n", ihx->regions[n].address,
+            ihx->regions[n].sz, n);
+    fputs("};\n", f);
+}
+
+// write C Include output compressed in LZ4 block format
+// decoder inflates it into caller buffer of IMAGE_SIZE bytes
+void c_lz4_dump(IHX* ihx, FILE* f)
+{
+    uint8_t* packed = (uint8_t*)z_malloc(lz4_bound(ihx->sz));
+    size_t sz = lz4_compress(ihx->image, ihx->sz, packed);
+
+    c_header(ihx, f);
+    fprintf(f, "// LZ4 block, %zu bytes unpacked\n", ihx->sz);
+    fprintf(f, "#define IMAGE_SIZE %zuu\n", ihx->sz);
+    c_array("image_lz4", packed, sz, 0, 1, f);
+    lz4_decoder("image_lz4_decode", f);
+    fputs("static unsigned long image_unpack(unsigned char* dst)\n"
+          "{\n"
+          "    return image_lz4_decode(dst, image_lz4, sizeof(image_lz4));\n"
+          "}\n", f);
+
+    free(packed);
+}
+
+// write bytes as C string literal contents, up to 4 chars each
+// return end of output
+static char* c_escape(char* ptr, const uint8_t* data, size_t n)
+{
+    for (size_t j = 0; j < n; ++j) {
+        uint8_t c = data[j];
+        if (c >= ' ' && c <= '~' && c != '"' && c != '\\' && c != '?')
+            *ptr++ = c;
+        else if (c == '"' || c == '\\' || c == '?') {
+            *ptr++ = '\\';
+            *ptr++ = c;
+        } else {
+            // octal escape takes up to three digits, so make it
+            // full width if followed by another octal digit
+            uint8_t next = (j + 1 < n) ? data[j + 1] : 0;
+            bool full = (next >= '0' && next <= '7');
+            *ptr++ = '\\';
+            if (full || c >= 0100)
+                *ptr++ = '0' + (c >> 6);
+            if (full || c >= 010)
+                *ptr++ = '0' + ((c >> 3) & 7);
+            *ptr++ = '0' + (c & 7);
+        }
+    }
+    return ptr;
+}
+
+// string hash (FNV-1a) with seed
+static uint32_t name_hash(uint32_t seed, const char* name)
+{
+    uint32_t h = 2166136261u ^ seed;
+    for (; *name != 0; ++name)
+        h = (h ^ (uint8_t)*name) * 16777619u;
+    return h;
+}
+
+// build perfect hash by "hash and displace" method
+// slot of name = name_hash(disp[name_hash(0, name) % n], name) % n
+// return false if names are not unique
+static bool perfect_hash(char** names, size_t n, uint32_t* disp, size_t* slot)
+{
+    size_t* bucket = (size_t*)z_malloc(n * sizeof(size_t));
+    size_t* order = (size_t*)z_malloc(n * sizeof(size_t));
+    size_t* count = (size_t*)calloc(n, sizeof(size_t));
+    bool* taken = (bool*)calloc(n, sizeof(bool));
+    if (count == NULL || taken == NULL)
+        z_error(EXIT_FAILURE, errno, "calloc(%zu)", n);
+
+    for (size_t i = 0; i < n; ++i) {
+        bucket[i] = name_hash(0, names[i]) % n;
+        ++count[bucket[i]];
+        order[i] = i;
+    }
+    // place biggest buckets first
+    for (size_t i = 1; i < n; ++i)
+        for (size_t j = i; j > 0 && count[order[j - 1]] < count[order[j]]; --j) {
+            size_t t = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = t;
+        }
+
+    bool ok = true;
+    for (size_t k = 0; ok && k < n && count[order[k]] > 0; ++k) {
+        size_t b = order[k];
+        for (disp[b] = 1; ; ++disp[b]) {
+            // try to put all bucket names into free slots
+            size_t placed = 0;
+            for (size_t i = 0; i < n; ++i) {
+                if (bucket[i] != b)
+                    continue;
+                slot[i] = name_hash(disp[b], names[i]) % n;
+                if (taken[slot[i]])
+                    break;
+                taken[slot[i]] = true;
+                ++placed;
+            }
+            if (placed == count[b])
+                break;
+            // roll back
+            for (size_t i = 0; placed > 0; ++i)
+                if (bucket[i] == b) {
+                    taken[slot[i]] = false;
+                    --placed;
+                }
+            if (disp[b] == 0x100000) {
+                ok = false;
+                break;
+            }
+        }
+    }
+
+    free(taken);
+    free(count);
+    free(order);
+    free(bucket);
+    return ok;
+}
+
+// write C Include output of several images
+// images are packed into one array and found by name with perfect hash
+void c_bundle_dump(IHX* ihx, size_t n, FILE* f)
+{
+    size_t align = opt.align ? opt.align : 1;
+    uint32_t* disp = (uint32_t*)calloc(n, sizeof(uint32_t));
+    size_t* slot = (size_t*)z_malloc(n * sizeof(size_t));
+    size_t* offset = (size_t*)z_malloc(n * sizeof(size_t));
+    if (disp == NULL)
+        z_error(EXIT_FAILURE, errno, "calloc(%zu)", n);
+    if (!perfect_hash(opt.inputs, n, disp, slot))
+        z_error(EXIT_FAILURE, EINVAL, "duplicate file name");
+
+    // pack images
+    size_t total = 0;
+    for (size_t i = 0; i < n; ++i) {
+        offset[i] = (total + align - 1) / align * align;
+        total = offset[i] + ihx[i].sz;
+    }
+    uint8_t* data = (uint8_t*)z_malloc(total);
+    if (total > 0)
+        memset(data, (opt.filler <= UINT8_MAX) ? opt.filler : 0, total);
+    for (size_t i = 0; i < n; ++i)
+        if (ihx[i].sz > 0)  // image of empty input is NULL
+            memcpy(data + offset[i], ihx[i].image, ihx[i].sz);
+
+    // header
+    fprintf(f, "// made with %s\n", z_getprogname());
+    fprintf(f, "// bundle of %zu files\n", n);
+    fprintf(f, "#define BUNDLE_COUNT %zuu\n", n);
+    c_array("bundle_data", data, total, 0, 1, f);
+
+    // name pool, names are escaped once for string literals and comments
+    char** names = (char**)z_malloc(n * sizeof(char*));
+    fputs("const char bundle_names[] =\n", f);
+    for (size_t i = 0; i < n; ++i) {
+        size_t len = strlen(opt.inputs[i]);
+        names[i] = (char*)z_malloc(4 * len + 1);
+        *c_escape(names[i], (const uint8_t*)opt.inputs[i], len) = 0;
+        fprintf(f, "    \"%s\\0\"\n", names[i]);
+    }
+    fputs(";\n", f);
+
+    // index ordered by slot: name offset, data offset, size
+    size_t* name_offset = (size_t*)z_malloc(n * sizeof(size_t));
+    size_t* by_slot = (size_t*)z_malloc(n * sizeof(size_t));
+    for (size_t i = 0, pool = 0; i < n; pool += strlen(opt.inputs[i++]) + 1) {
+        name_offset[i] = pool;
+        by_slot[slot[i]] = i;
+    }
+    fputs("const unsigned long bundle_index[BUNDLE_COUNT][3] = {\n", f);
+    for (size_t k = 0; k < n; ++k) {
+        size_t i = by_slot[k];
+        // quoted, so that trailing backslash cannot continue comment
+        fprintf(f, "    { %zu, %zu, %zu }, // \"%s\"\n", name_offset[i], offset[i],
+            ihx[i].sz, names[i]);
+    }
+    fputs("};\n", f);
+    fputs("const unsigned long bundle_disp[BUNDLE_COUNT] = {\n", f);
+    for (size_t k = 0; k < n; ++k)
+        fprintf(f, "    %lu,\n", (unsigned long)disp[k]);
+    fputs("};\n", f);
+
+    // lookup function
+    fputs(
+"static unsigned long bundle_hash(unsigned long h, const char* name)\n"
+"{\n"
+"    h = (h ^ 2166136261ul) & 0xfffffffful;\n"
+"    for (; *name != 0; ++name)\n"
+"        h = ((h ^ (unsigned char)*name) * 16777619ul) & 0xfffffffful;\n"
+"    return h;\n"
+"}\n"
+"static const unsigned char* bundle_find(const char* name, unsigned long* size)\n"
+"{\n"
+"    unsigned long h = bundle_hash(0, name) % BUNDLE_COUNT;\n"
+"    const unsigned long* entry = bundle_index[bundle_hash(bundle_disp[h], name)\n"
+"        % BUNDLE_COUNT];\n"
+"    const char* str = bundle_names + entry[0];\n"
+"    for (; *name != 0 && *name == *str; ++name, ++str) ;\n"
+"    if (*name != *str)\n"
+"        return 0;\n"
+"    if (size != 0)\n"
+"        *size = entry[2];\n"
+"    return bundle_data + entry[1];\n"
+"}\n", f);
+
+    for (size_t i = 0; i < n; ++i)
+        free(names[i]);
+    free(names);
+    free(by_slot);
+    free(name_offset);
+    free(data);
+    free(offset);
+    free(slot);
+    free(disp);
+}
+
+// write C Include output file as string literal
+// array is declared without room for terminating NUL
+void c_string_dump(IHX* ihx, FILE* f)
+{
+    // user options
+    unsigned wrap = opt.wrap ? opt.wrap : 16;
+    unsigned padding = opt.padding ? opt.padding : 4;
+
+    // header
+    c_header(ihx, f);
+    c_decl("unsigned char", "image", ihx->sz, f);
+    fputs(" =\n", f);
+
+    for (size_t i = 0; i < ihx->sz; i += wrap) {
+        char line[4 * UINT8_MAX + 3], *ptr = line;
+        *ptr++ = '"';
+
+        // data
+        ptr = c_escape(ptr, ihx->image + i, min(wrap, ihx->sz - i));
+        *ptr++ = '"';
+        *ptr = 0;
+
+        fprintf(f, "%*c%-*s// %03zx\n", padding, ' ', 4 * wrap + 2 + padding, line,
+            ihx->base + i);
+    }
+
+    // footer
+    fputs(";\n", f);
+}
+
+// write raw binary next to C23 #embed header or assembler .incbin stub
+void embed_dump(IHX* ihx, FILE* f, bool incbin)
+{
+    // binary data
+    char* bin_name = aux_name(opt.output, ".bin");
+    char* tmp;
+    FILE* fbin = out_open(bin_name, "wb", &tmp);
+    if (fwrite(ihx->image, 1, ihx->sz, fbin) != ihx->sz)
+        z_error(EXIT_FAILURE, errno, "fwrite(%zu)", ihx->sz);
+    out_close(fbin, bin_name, tmp);
+
+    // header or stub referring to it
+    const char* name = z_basename(bin_name);
+    if (incbin) {
+        comment_header(ihx, f);
+        fprintf(f, "// extern const unsigned char image[%zu];\n", ihx->sz);
+        if (opt.section != NULL)
+            fprintf(f, "    .section %s, \"a\"\n", opt.section);
+        else
+            fputs("    .section .rodata\n", f);
+        if (opt.align > 0)
+            fprintf(f, "    .balign %u\n", opt.align);
+        fprintf(f,
+"    .global image\n"
+"image:\n"
+"    .incbin \"%s\"\n", name);
+    } else {
+        c_header(ihx, f);
+        c_decl("unsigned char", "image", ihx->sz, f);
+        fprintf(f, " = {\n#embed \"%s\"\n};\n", name);
+    }
+
+    free(bin_name);
+}
+
+// write FPGA memory initialization file
+// addresses are in words relative to image base
+// $readmemh and MIF skip words outside regions, COE is always contiguous
+void mem_dump(IHX* ihx, int fmt, FILE* f)
+{
+    unsigned word = opt.word;
+    size_t depth = c_count(ihx->sz, word);
+
+    // header
+    switch (fmt) {
+    case OPT_READMEMH:
+        fprintf(f, "// made with %s\n", z_getprogname());
+        if (ihx->base > 0)
+            fprintf(f, "// image base %#04zx\n", ihx->base);
+    break;
+    case OPT_MIF:
+        fprintf(f, "-- made with %s\n", z_getprogname());
+        if (ihx->base > 0)
+            fprintf(f, "-- image base %#04zx\n", ihx->base);
+        fprintf(f, "DEPTH = %zu;\nWIDTH = %u;\n", depth, 8 * word);
+        fputs("ADDRESS_RADIX = HEX;\nDATA_RADIX = HEX;\nCONTENT\nBEGIN\n", f);
+    break;
+    case OPT_COE:
+        fprintf(f, "; made with %s\n", z_getprogname());
+        if (ihx->base > 0)
+            fprintf(f, "; image base %#04zx\n", ihx->base);
+        fputs("memory_initialization_radix=16;\nmemory_initialization_vector=\n", f);
+    break;
+    }
+
+    size_t region = 0, next = 0;
+    for (size_t n = 0; n < depth; ++n) {
+        size_t address = ihx->base + n * word;
+        if (fmt != OPT_COE) {
+            // jump over gap
+            while (region < ihx->nregions
+                && ihx->regions[region].address + ihx->regions[region].sz <= address)
+                ++region;
+            if (region == ihx->nregions)
+                break;
+            if (ihx->regions[region].address >= address + word) {
+                n = (ihx->regions[region].address - ihx->base) / word;
+                address = ihx->base + n * word;
+            }
+        }
+
+        char line[48];
+        unsigned long long value = get_word(ihx->image, ihx->sz, n * word, word);
+        switch (fmt) {
+        case OPT_READMEMH:
+            if (n != next)
+                fprintf(f, "@%zx\n", n);
+            snprintf(line, sizeof(line), "%0*llx\n", 2 * word, value);
+        break;
+        case OPT_MIF:
+            snprintf(line, sizeof(line), "%zX : %0*llX;\n", n, 2 * word, value);
+        break;
+        case OPT_COE:
+            snprintf(line, sizeof(line), "%0*llX%s\n", 2 * word, value,
+                (n + 1 < depth) ? "," : ";");
+        break;
+        }
+        fputs(line, f);
+        next = n + 1;
+    }
+
+    // footer
+    if (fmt == OPT_MIF)
+        fputs("END;\n", f);
+    else if (fmt == OPT_COE && depth == 0)
+        fputs(";\n", f);
+}
+
+// write canonical hex+ASCII dump (like hexdump -C)
+// repeated lines are replaced with single asterisk
+void hexdump(IHX* ihx, FILE* f)
+{
+    static const char digits[] = "0123456789abcdef";
+    bool repeat = false;
+
+    for (size_t i = 0; i < ihx->sz; i += 16) {
+        unsigned cb = min(16, ihx->sz - i);
+        const uint8_t* data = ihx->image + i;
+        if (i > 0 && cb == 16 && memcmp(data, data - 16, 16) == 0) {
+            if (!repeat)
+                fputs("*\n", f);
+            repeat = true;
+            continue;
+        }
+        repeat = false;
+
+        // offset, hex and ASCII columns
+        char line[32 + 3 * 16 + 16 + 4];
+        int n = snprintf(line, sizeof(line), "%08zx  ", ihx->base + i);
+        char* hex = line + n;
+        char* ascii = hex + 3 * 16 + 3;
+        memset(hex, ' ', ascii - hex);
+        for (unsigned j = 0; j < cb; ++j) {
+            char* ptr = hex + 3 * j + (j >= 8);
+            ptr[0] = digits[data[j] >> 4];
+            ptr[1] = digits[data[j] & 15];
+            ascii[j] = (data[j] >= ' ' && data[j] <= '~') ? data[j] : '.';
+        }
+        ascii[-1] = '|';
+        ascii[cb] = '|';
+        ascii[cb + 1] = '\n';
+        fwrite(line, 1, ascii + cb + 2 - line, f);
+    }
+
+    if (ihx->sz > 0)
+        fprintf(f, "%08zx\n", ihx->base + ihx->sz);
+}
+
+// write digest as hex string
+static void put_digest(const uint8_t* digest, FILE* f)
+{
+    for (unsigned i = 0; i < SHA256_SIZE; ++i)
+        fprintf(f, "%02x", digest[i]);
+}
+
+// compute SHA-256 digest of image, or root of Merkle tree over chunk hashes
+// node is hash of two children, odd node is promoted to upper level as is
+// last chunk is not padded, gaps are hashed as filler bytes
+// if leaf != NULL then also store chunk hashes there
+static void image_digest(IHX* ihx, size_t chunk, uint8_t (*leaf)[SHA256_SIZE],
+    uint8_t root[SHA256_SIZE])
+{
+    if (chunk == 0)
+        chunk = max(ihx->sz, 1);
+    size_t n = max((ihx->sz + chunk - 1) / chunk, 1);
+    uint8_t (*node)[SHA256_SIZE] = (uint8_t (*)[SHA256_SIZE])z_malloc(n * SHA256_SIZE);
+
+    for (size_t i = 0; i < n; ++i)
+        sha256(ihx->image + i * chunk, min(chunk, ihx->sz - i * chunk), node[i]);
+    if (leaf != NULL)
+        memcpy(leaf, node, n * SHA256_SIZE);
+
+    // reduce tree level by level
+    for (size_t m = n; m > 1; m = (m + 1) / 2) {
+        for (size_t i = 0; i < m / 2; ++i)
+            sha256(node[2 * i], 2 * SHA256_SIZE, node[i]);
+        if (m & 1)
+            memcpy(node[m / 2], node[m - 1], SHA256_SIZE);
+    }
+
+    memcpy(root, node[0], SHA256_SIZE);
+    free(node);
+}
+
+// write SHA-256 digest of image (like sha256sum)
+// with chunk size, write root of Merkle tree and optional leaf hashes
+void digest_dump(IHX* ihx, FILE* f)
+{
+    size_t chunk = opt.digest_chunk;
+    size_t n = chunk ? max((ihx->sz + chunk - 1) / chunk, 1) : 1;
+    uint8_t (*leaf)[SHA256_SIZE] = opt.digest_leaves ?
+        (uint8_t (*)[SHA256_SIZE])z_malloc(n * SHA256_SIZE) : NULL;
+    uint8_t root[SHA256_SIZE];
+    image_digest(ihx, chunk, leaf, root);
+
+    put_digest(root, f);
+    fprintf(f, "  %s\n", opt.input);
+    if (leaf != NULL)
+        for (size_t i = 0; i < n; ++i) {
+            put_digest(leaf[i], f);
+            fprintf(f, "  %08zx\n", ihx->base + i * chunk);
+        }
+
+    free(leaf);
+}
@@ -1,4 +1,5 @@
 #include "ihx.h"
+#include "elf.h"
 #include "stdz.h"
 
 #define MIN_BYTES   5
@@ -31,19 +32,65 @@ static int char2hex(int c)
     return -1;
 }
 
+// convert hex pairs to bytes
+// return number of bytes converted
+static size_t hex2bin(uint8_t* blob, size_t n, const char* str)
+{
+    size_t bloblen = 0;
+    for (; bloblen < n; str += 2) {
+        int high = char2hex(str[0]);
+        if (high < 0)
+            break;
+        int low = char2hex(str[1]);
+        if (low < 0)
+            break;
+        blob[bloblen++] = (high << 4) | low;
+    }
+    return bloblen;
+}
+
+// convert bytes to hex pairs and write them out
+static void bin2hex(const uint8_t* blob, size_t n, FILE* f)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    char str[2 * MAX_BYTES];
+    for (size_t i = 0; i < n; ++i) {
+        str[2 * i] = digits[blob[i] >> 4];
+        str[2 * i + 1] = digits[blob[i] & 15];
+    }
+    fwrite(str, 1, 2 * n, f);
+}
+
+// sum of bytes modulo 256
+static uint8_t sum_bytes(const uint8_t* blob, size_t n)
+{
+    uint8_t sum = 0;
+    for (size_t i = 0; i < n; ++i)
+        sum += blob[i];
+    return sum;
+}
+
 static unsigned make16(unsigned high, unsigned low)
 {
     return (high << 8) + low;
 }
 
-static unsigned sum8(unsigned word)
+// length of line without newline characters
+static unsigned line_length(const char* line)
 {
-    return (word >> 8) + word;
+    unsigned length = strlen(line);
+    if (length > 0 && line[length - 1] == '\n')
+        --length;
+    if (length > 0 && line[length - 1] == '\r')
+        --length;
+    return length;
 }
 
 // parse one record
+// DATA outside [from, to) window is returned empty without decoding payload
 // return record type or -1
-static int parse_record(CHUNK* pc, const char* line)
+static int parse_record(CHUNK* pc, const char* line, size_t segment, size_t from,
+    size_t to)
 {
     // init chunk
     pc->count = 0;
@@ -51,11 +98,7 @@ static int parse_record(CHUNK* pc, const char* line)
     pc->type = -1;
 
     // cut newline character
-    unsigned length = strlen(line);
-    if (length > 0 && line[length - 1] == '\n')
-        --length;
-    if (length > 0 && line[length - 1] == '\r')
-        --length;
+    unsigned length = line_length(line);
 
     // allow for empty lines and comments (non-standard feature)
     if (length == 0 || line[0] == ';')
@@ -68,33 +111,29 @@ static int parse_record(CHUNK* pc, const char* line)
     if (length < MIN_LINE || length > MAX_LINE || !(length & 1))
         return -1;
 
-    // convert line to byte array
+    // get count, address and type
     uint8_t blob[MAX_BYTES];
-    size_t bloblen = 0;
-    for (size_t i = 1; bloblen < MAX_BYTES; i += 2) {
-        int high = char2hex(line[i]);
-        if (high < 0)
-            break;
-        int low = char2hex(line[i + 1]);
-        if (low < 0)
-            break;
-        blob[bloblen++] = (high << 4) | low;
-    }
-    if (bloblen != (length - 1) / 2)
+    if (hex2bin(blob, 4, line + 1) != 4)
         return -1;
-
-    // get count, address and type
     unsigned count = blob[0];
     unsigned address = make16(blob[1], blob[2]);
     unsigned type = blob[3];
-    if (count != bloblen - MIN_BYTES || address + count > 0x10000)
+    if (count != (length - 1) / 2 - MIN_BYTES || address + count > 0x10000)
+        return -1;
+
+    // skip data outside window
+    if (type == 0 && (segment + address + count <= from || segment + address >= to)) {
+        pc->type = 0;
+        return 0;
+    }
+
+    // convert rest of line to byte array
+    size_t bloblen = 4 + hex2bin(blob + 4, MAX_BYTES - 4, line + 9);
+    if (bloblen != (length - 1) / 2)
         return -1;
 
     // verify checksum
-    uint8_t sum = 0;
-    for (size_t i = 0; i < bloblen; ++i)
-        sum += blob[i];
-    if (sum != 0)
+    if (sum_bytes(blob, bloblen) != 0)
         return -1;
 
     pc->count = count;
@@ -104,14 +143,139 @@ static int parse_record(CHUNK* pc, const char* line)
     return pc->type;
 }
 
-// convert Intel HEX to Binary image
+// address length of S-record type
+static unsigned srec_addrlen(unsigned type)
+{
+    static const uint8_t addrlen[10] = { 2, 2, 3, 4, 0, 2, 3, 4, 3, 2 };
+    return addrlen[type];
+}
+
+// parse one Motorola S-record
+// data (S1-S3) is returned as DATA with absolute address
+// termination (S7-S9) is returned as EOF with start address
+// other records, and data outside [from, to) window, are returned as empty DATA
+// return record type or -1
+static int parse_srec(CHUNK* pc, const char* line, size_t from, size_t to)
+{
+    // init chunk
+    pc->count = 0;
+    pc->address = 0;
+    pc->type = -1;
+
+    // S type count address checksum
+    unsigned length = line_length(line);
+    if (length < 2 + 2 * 4 || (length & 1) || line[0] != 'S' || line[1] < '0'
+        || line[1] > '9' || line[1] == '4')
+        return -1;
+    unsigned type = line[1] - '0', addrlen = srec_addrlen(type);
+
+    // get count and address
+    uint8_t blob[MAX_BYTES];
+    if (hex2bin(blob, 1 + addrlen, line + 2) != 1 + addrlen
+        || blob[0] != (length - 2) / 2 - 1 || blob[0] < addrlen + 1)
+        return -1;
+    size_t address = 0;
+    for (unsigned i = 1; i <= addrlen; ++i)
+        address = (address << 8) | blob[i];
+
+    // skip data outside window
+    size_t count = blob[0] - addrlen - 1;
+    if (type >= 1 && type <= 3 && (address + count <= from || address >= to)) {
+        pc->type = 0;
+        return 0;
+    }
+
+    // convert rest of line to byte array
+    size_t bloblen = 1 + addrlen + hex2bin(blob + 1 + addrlen, MAX_BYTES - 1 - addrlen,
+        line + 2 + 2 * (1 + addrlen));
+    if (bloblen != (length - 2) / 2)
+        return -1;
+
+    // verify checksum
+    if (sum_bytes(blob, bloblen) != 0xff)
+        return -1;
+
+    switch (type) {
+    case 1:
+    case 2:
+    case 3:
+        pc->type = 0;
+        pc->count = blob[0] - addrlen - 1;
+        pc->address = address;
+        memcpy(pc->data, &blob[1 + addrlen], pc->count);
+    break;
+    case 7:
+    case 8:
+    case 9:
+        pc->type = 1;
+        pc->address = address;
+    break;
+    default:
+        pc->type = 0;
+    break;
+    }
+    return pc->type;
+}
+
+// add data range to region list
+// list is kept sorted and coalesced
+void ihx_add_region(IHX* ihx, size_t address, size_t sz)
+{
+    size_t n = ihx->nregions;
+    IHX_REGION* r = ihx->regions;
+
+    // most records just continue previous one
+    if (n > 0 && r[n - 1].address <= address
+        && address <= r[n - 1].address + r[n - 1].sz) {
+        r[n - 1].sz = max(r[n - 1].sz, address + sz - r[n - 1].address);
+        return;
+    }
+
+    // capacity is next power of two
+    if ((n & (n - 1)) == 0)
+        ihx->regions = r = (IHX_REGION*)z_realloc(r, (n ? 2 * n : 1) * sizeof(IHX_REGION));
+
+    // find insertion point
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (r[mid].address <= address)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    memmove(&r[lo + 1], &r[lo], (n - lo) * sizeof(IHX_REGION));
+    r[lo] = (IHX_REGION){ .address = address, .sz = sz };
+    ++n;
+
+    // merge with previous and following regions
+    if (lo > 0 && r[lo].address <= r[lo - 1].address + r[lo - 1].sz)
+        --lo;
+    size_t next = lo + 1;
+    for (; next < n && r[next].address <= r[lo].address + r[lo].sz; ++next)
+        r[lo].sz = max(r[lo].sz, r[next].address + r[next].sz - r[lo].address);
+    memmove(&r[lo + 1], &r[next], (n - next) * sizeof(IHX_REGION));
+    ihx->nregions = n - (next - lo - 1);
+}
+
+// convert Intel HEX or S-record to Binary image
 int ihx_load(IHX* ihx, unsigned filler, FILE* f)
+{
+    return ihx_load_range(ihx, filler, 0, SIZE_MAX, f);
+}
+
+// convert Intel HEX or S-record to Binary image
+// data outside [from, to) is dropped, image buffer starts at from
+int ihx_load_range(IHX* ihx, unsigned filler, size_t from, size_t to, FILE* f)
 {
     size_t segment = 0, blocksize = 0x10000;    // 64 KB
     size_t start = SIZE_MAX, end = 0, eip = 0;
+    int fmt = 'x';
 
     ihx->image = (uint8_t*)memset(z_malloc(blocksize), min(filler, 255), blocksize);
     ihx->sz = ihx->base = ihx->entry = 0;
+    ihx->regions = NULL;
+    ihx->nregions = 0;
 
     bool found_eof = false;
     do {
@@ -120,31 +284,47 @@ int ihx_load(IHX* ihx, unsigned filler, FILE* f)
             break;
 
         CHUNK chunk;
-        switch (parse_record(&chunk, line)) {
+        int type;
+        if (line[0] == 'S') {
+            fmt = 's';
+            type = parse_srec(&chunk, line, from, to);
+        } else
+            type = parse_record(&chunk, line, segment, from, to);
+
+        switch (type) {
         case 0: /* DATA */
             if (chunk.count > 0) {
-                // parse_record() guarantees never getting past 64 KB
-                memcpy(ihx->image + segment + chunk.address, chunk.data, chunk.count);
-                start = min(start, segment + chunk.address);
-                end = max(end, segment + chunk.address + chunk.count);
+                // crop to address window
+                size_t address = segment + chunk.address;
+                size_t first = max(address, from);
+                size_t last = min(address + chunk.count, to);
+                if (first >= last)
+                    break;
+                // grow image if not enough room
+                if (last - from > blocksize) {
+                    size_t newsize = last - from + 0x100000; // +1 MB
+                    ihx->image = (uint8_t*)z_realloc(ihx->image, newsize);
+                    memset(ihx->image + blocksize, min(filler, 255),
+                        newsize - blocksize);
+                    blocksize = newsize;
+                }
+                memcpy(ihx->image + (first - from), chunk.data + (first - address),
+                    last - first);
+                start = min(start, first);
+                end = max(end, last);
+                ihx_add_region(ihx, first, last - first);
             }
         break;
         case 1: /* EOF */
             found_eof = (chunk.count == 0);
+            if (fmt == 's')
+                eip = chunk.address;
         break;
         case 2: /* CS */
         case 4: /* HIWORD(ADDRESS32) */
             if (chunk.count == 2) {
                 segment = make16(chunk.data[0], chunk.data[1]);
                 segment <<= (chunk.type == 2) ? 4 : 16;
-                // grow image if less than 64 KB remaining
-                if (segment + 0x10000 > blocksize) {
-                    size_t newsize = segment + 0x100000; // +1 MB
-                    ihx->image = (uint8_t*)z_realloc(ihx->image, newsize);
-                    memset(ihx->image + blocksize, min(filler, 255),
-                        newsize - blocksize);
-                    blocksize = newsize;
-                }
             }
         break;
         case 3: /* CS:IP */
@@ -157,18 +337,26 @@ int ihx_load(IHX* ihx, unsigned filler, FILE* f)
         break;
         case -1:
         default:
-            // assume Binary file
+            ihx_free(ihx);
+            // try ELF file
+            type = elf_load(ihx, filler, from, to, f);
+            if (type != 0)
+                return type;
+            // assume Binary file, read only the window
+            // window past end of file gives empty image as with HEX
             if (fseek(f, 0, SEEK_END) == 0) {
                 long t = ftell(f);
-                if (t > 0) {
-                    fseek(f, 0, SEEK_SET);
-                    ihx->image = (uint8_t*)z_realloc(ihx->image, t);
-                    ihx->sz = fread(ihx->image, 1, t, f);
-                    return 'b';
+                if (t > 0 && (size_t)t > from) {
+                    size_t sz = min((size_t)t, to) - from;
+                    fseek(f, from, SEEK_SET);
+                    ihx->image = (uint8_t*)z_malloc(sz);
+                    ihx->sz = fread(ihx->image, 1, sz, f);
+                    ihx->base = ihx->entry = from;
+                    ihx_add_region(ihx, from, ihx->sz);
                 }
+                if (t > 0)
+                    return 'b';
             }
-            free(ihx->image);
-            ihx->image = NULL;
             return -1;
         break;
         }
@@ -176,8 +364,8 @@ int ihx_load(IHX* ihx, unsigned filler, FILE* f)
 
     if (start < end) {
         // rebase image
-        if (start > 0)
-            memmove(ihx->image, ihx->image + start, end - start);
+        if (start > from)
+            memmove(ihx->image, ihx->image + (start - from), end - start);
         ihx->sz = end - start;
         ihx->base = start;
         ihx->entry = (start <= eip && eip < end) ? eip : start;
@@ -185,66 +373,231 @@ int ihx_load(IHX* ihx, unsigned filler, FILE* f)
 
     // shrink memory block
     ihx->image = (uint8_t*)z_realloc(ihx->image, ihx->sz);
-    return 'x';
+    return fmt;
 }
 
-// format output as Intel HEX file
-void ihx_dump(IHX* ihx, unsigned filler, unsigned wrap, FILE* f)
+// check if any data ranges of two images overlap
+// both region lists are sorted, so walk them together
+bool ihx_overlap(const IHX* a, const IHX* b)
+{
+    for (size_t i = 0, j = 0; i < a->nregions && j < b->nregions; ) {
+        const IHX_REGION* ra = &a->regions[i];
+        const IHX_REGION* rb = &b->regions[j];
+        if (ra->address + ra->sz <= rb->address)
+            ++i;
+        else if (rb->address + rb->sz <= ra->address)
+            ++j;
+        else
+            return true;
+    }
+    return false;
+}
+
+// copy loaded data of src into image buffer starting at base
+static void copy_regions(uint8_t* image, size_t base, const IHX* src)
+{
+    for (size_t i = 0; i < src->nregions; ++i)
+        memcpy(image + (src->regions[i].address - base),
+            src->image + (src->regions[i].address - src->base), src->regions[i].sz);
+}
+
+// merge data of src into ihx
+void ihx_merge(IHX* ihx, const IHX* src, unsigned filler, bool overwrite)
+{
+    if (src->nregions == 0)
+        return;
+    if (ihx->nregions == 0) {
+        ihx->entry = src->entry;
+        ihx->base = src->base;
+    }
+
+    // new buffer for combined address range
+    size_t base = min(ihx->base, src->base);
+    size_t top = max(ihx->base + ihx->sz, src->base + src->sz);
+    uint8_t* image = (uint8_t*)memset(z_malloc(top - base), min(filler, 255), top - base);
+
+    // later copy wins
+    const IHX* first = overwrite ? ihx : src;
+    const IHX* last = overwrite ? src : ihx;
+    copy_regions(image, base, first);
+    copy_regions(image, base, last);
+
+    free(ihx->image);
+    ihx->image = image;
+    ihx->sz = top - base;
+    ihx->base = base;
+    for (size_t i = 0; i < src->nregions; ++i)
+        ihx_add_region(ihx, src->regions[i].address, src->regions[i].sz);
+}
+
+// free memory allocated by ihx_load()
+void ihx_free(IHX* ihx)
+{
+    free(ihx->regions);
+    free(ihx->image);
+    ihx->regions = NULL;
+    ihx->image = NULL;
+    ihx->nregions = ihx->sz = ihx->base = ihx->entry = 0;
+}
+
+// check if image[i..end) has nothing to write
+// i.e. lies outside regions or consists of filler bytes only
+static bool is_blank(IHX* ihx, unsigned filler, size_t i, size_t end, size_t* region)
+{
+    // regions are sorted and we only go forward
+    while (*region < ihx->nregions
+        && ihx->regions[*region].address + ihx->regions[*region].sz <= ihx->base + i)
+        ++*region;
+    if (*region == ihx->nregions || ihx->regions[*region].address >= ihx->base + end)
+        return true;
+
+    if (filler > 255)
+        return false;
+    for (; i < end; ++i)
+        if (ihx->image[i] != filler)
+            return false;
+    return true;
+}
+
+// check if loaded data in image[i..end) is the same in reference image
+// gaps between regions are not compared
+static bool is_same(IHX* ihx, const IHX* ref, size_t i, size_t end, size_t* region)
+{
+    while (*region < ihx->nregions
+        && ihx->regions[*region].address + ihx->regions[*region].sz <= ihx->base + i)
+        ++*region;
+
+    for (size_t k = *region; k < ihx->nregions; ++k) {
+        const IHX_REGION* r = &ihx->regions[k];
+        if (r->address >= ihx->base + end)
+            break;
+        size_t first = max(r->address, ihx->base + i);
+        size_t last = min(r->address + r->sz, ihx->base + end);
+        if (first < ref->base || last > ref->base + ref->sz
+            || memcmp(ihx->image + (first - ihx->base), ref->image + (first - ref->base),
+                last - first) != 0)
+            return false;
+    }
+    return true;
+}
+
+// write Intel HEX record
+static void put_record(unsigned type, unsigned address, const uint8_t* data,
+    unsigned count, FILE* f)
+{
+    uint8_t blob[MAX_BYTES];
+    blob[0] = count;
+    blob[1] = (uint8_t)(address >> 8);
+    blob[2] = (uint8_t)address;
+    blob[3] = type;
+    if (count > 0)
+        memcpy(&blob[4], data, count);
+    blob[4 + count] = -sum_bytes(blob, 4 + count);
+
+    fputc(':', f);
+    bin2hex(blob, 5 + count, f);
+    fputc('\n', f);
+}
+
+// write Motorola S-record
+static void put_srec(unsigned type, size_t address, const uint8_t* data,
+    unsigned count, FILE* f)
+{
+    uint8_t blob[MAX_BYTES];
+    unsigned addrlen = srec_addrlen(type);
+    blob[0] = addrlen + count + 1;
+    for (unsigned i = addrlen; i > 0; --i, address >>= 8)
+        blob[i] = (uint8_t)address;
+    if (count > 0)
+        memcpy(&blob[1 + addrlen], data, count);
+    blob[1 + addrlen + count] = ~sum_bytes(blob, 1 + addrlen + count);
+
+    fprintf(f, "S%u", type);
+    bin2hex(blob, 2 + addrlen + count, f);
+    fputc('\n', f);
+}
+
+// format output as Intel HEX or S-record file
+static void dump(IHX* ihx, const IHX* ref, unsigned filler, unsigned wrap, unsigned page,
+    int fmt, FILE* f)
 {
-    size_t segment = ihx->base & 0xffff0000;    // over 64 KB
-    bool use32 = (ihx->sz > 0x100000);          // size > 1 MB
+    size_t segment = 0;                         // last address record
+    size_t top = ihx->base + ihx->sz;
+    bool use32 = (top > 0x100000);              // above 1 MB
+    size_t region = 0, ref_region = 0;
+
+    // S1, S2 or S3 by highest address
+    unsigned srec_type = (top <= 0x10000) ? 1 : (top <= 0x1000000) ? 2 : 3;
 
     if (wrap == 0)
         wrap = 16;
+    if (fmt == 's')
+        wrap = min(wrap, 255 - srec_addrlen(srec_type) - 1);
 
     for (size_t i = 0; i < ihx->sz; ) {
-        // segment overrun
-        if (segment <= ihx->base + i) {
-            // address output
-            if (segment > 0) {
-                unsigned type, high;
-                if (use32) {
-                    type = 4;   // HIWORD(ADDRESS32)
-                    high = segment >> 16;
-                } else {
-                    type = 2;   // CS
-                    high = segment >> 4;
-                }
-                int sum = 2 + type + sum8(high);
-                fprintf(f, ":020000%02X%04X%02X\n", type, high, (uint8_t)(-sum));
-            }
-            segment += 0x10000; // +64 KB
-        }
+        size_t address = ihx->base + i;
 
         // max number of bytes on line
-        unsigned cb_max = segment - ihx->base - i;
+        size_t cb_max = 0x10000 - (address & 0xffff);
+        if (page > 0) {
+            cb_max = min(cb_max, page - address % page);
+            // skip blank or unchanged page
+            // with ref, filler bytes in regions may erase old data and are kept
+            size_t end = min(i + cb_max, ihx->sz);
+            if (is_blank(ihx, ref ? UINT8_MAX + 1 : filler, i, end, &region)
+                || (ref != NULL
+                    && is_same(ihx, ref, i - min(i, address % page), end, &ref_region))) {
+                i += cb_max;
+                continue;
+            }
+        }
         cb_max = min(cb_max, ihx->sz - i);
         cb_max = min(cb_max, wrap);
 
+        // skip record outside regions or unchanged
+        if (ref != NULL && page == 0 && (is_blank(ihx, UINT8_MAX + 1, i, i + cb_max, &region)
+            || is_same(ihx, ref, i, i + cb_max, &ref_region))) {
+            i += cb_max;
+            continue;
+        }
+
         // skip trailing bytes
         unsigned cb_line = cb_max;
-        if (filler <= 255)
+        if (filler <= 255 && ref == NULL)
             for (; cb_line > 0; --cb_line)
                 if (ihx->image[i + cb_line - 1] != filler)
                     break;
 
-        if (cb_line > 0) {
-            // : count address type(00)
-            fprintf(f, ":%02X%04X00", cb_line, (uint16_t)(ihx->base + i));
-            int sum = cb_line + sum8(ihx->base + i);
-            // data
-            for (unsigned j = 0; j < cb_line; ++j) {
-                fprintf(f, "%02X", ihx->image[i + j]);
-                sum += ihx->image[i + j];
+        // segment overrun
+        // with page, address record is deferred until segment has data
+        if (fmt == 'x' && segment != (address & 0xffff0000) && (cb_line > 0 || page == 0)) {
+            segment = address & 0xffff0000;
+            unsigned type, high;
+            if (use32) {
+                type = 4;   // HIWORD(ADDRESS32)
+                high = segment >> 16;
+            } else {
+                type = 2;   // CS
+                high = segment >> 4;
             }
-            // checksum
-            fprintf(f, "%02X\n", (uint8_t)(-sum));
+            put_record(type, 0, (uint8_t[]){ high >> 8, high }, 2, f);
         }
 
+        if (cb_line > 0 && fmt == 's')
+            put_srec(srec_type, address, ihx->image + i, cb_line, f);
+        else if (cb_line > 0)
+            put_record(0, address, ihx->image + i, cb_line, f);
+
         // advance index
         i += cb_max;
     }
 
+    if (fmt == 's') {
+        // termination with start address
+        put_srec(10 - srec_type, ihx->entry, NULL, 0, f);
+        return;
+    }
+
     // start address
     if (ihx->entry > 0) {
         unsigned type, high;
@@ -255,11 +608,24 @@ void ihx_dump(IHX* ihx, unsigned filler, unsigned wrap, FILE* f)
             type = 3;
             high = (ihx->entry & 0xf0000) >> 4;
         }
-        int sum = 4 + type + sum8(high + ihx->entry);
-        fprintf(f, ":040000%02X%04X%04X%02X\n", type, high, (uint16_t)ihx->entry,
-            (uint8_t)(-sum));
+        put_record(type, 0, (uint8_t[]){ high >> 8, high, ihx->entry >> 8, ihx->entry },
+            4, f);
     }
 
     // EOF record
-    fputs(":00000001FF\n", f);
+    put_record(1, 0, NULL, 0, f);
+}
+
+// format output as Intel HEX file
+void ihx_dump(IHX* ihx, const IHX* ref, unsigned filler, unsigned wrap, unsigned page,
+    FILE* f)
+{
+    dump(ihx, ref, filler, wrap, page, 'x', f);
+}
+
+// format output as Motorola S-record file
+void srec_dump(IHX* ihx, const IHX* ref, unsigned filler, unsigned wrap, unsigned page,
+    FILE* f)
+{
+    dump(ihx, ref, filler, wrap, page, 's', f);
 }
@@ -1,6 +1,7 @@
 #if !defined(IHX_H)
 #define IHX_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -9,13 +10,20 @@
 extern "C" {
 #endif
 
+// contiguous range of loaded data
+typedef struct {
+    size_t address, sz;
+} IHX_REGION;
+
 typedef struct {
     uint8_t* image;
     size_t sz, base, entry;
+    IHX_REGION* regions;    // sorted and coalesced
+    size_t nregions;
 } IHX;
 
-// load Intel HEX or Binary file
-// note: may fseek(f), caller must free(image)
+// load Intel HEX, Motorola S-record, ELF or Binary file
+// note: may fseek(f), caller must ihx_free(ihx)
 int ihx_load(IHX* ihx, unsigned filler, FILE* f);
 // IHX ihx;
 // int fmt = ihx_load(&ihx, 0xff, f);
@@ -25,16 +33,45 @@ int ihx_load(IHX* ihx, unsigned filler, FILE* f);
 //     assert(ihx.sz == 0);
 //     assert(ihx.base == 0 && ihx.entry == 0);
 // } else {
-//     assert(fmt == 'x' || fmt == 'b');
+//     assert(fmt == 'x' || fmt == 's' || fmt == 'e' || fmt == 'b');
 //     assert(ihx.image != NULL);
 //     assert(ihx.sz > 0);
 //     assert(ihx.base <= ihx.entry && ihx.entry < ihx.base + ihx.sz);
+//     assert(ihx.nregions > 0 && ihx.regions[0].address == ihx.base);
 // }
 
+// same as ihx_load() but only keep data in [from, to) address window
+// records outside window are skipped before they take any memory
+int ihx_load_range(IHX* ihx, unsigned filler, size_t from, size_t to, FILE* f);
+
+// check if any data ranges of two images overlap
+bool ihx_overlap(const IHX* a, const IHX* b);
+
+// merge data of src into ihx
+// on overlap src bytes win if overwrite, else ihx bytes are kept
+// gaps are filled with filler, entry point of ihx is kept
+void ihx_merge(IHX* ihx, const IHX* src, unsigned filler, bool overwrite);
+
+// free memory allocated by ihx_load()
+void ihx_free(IHX* ihx);
+
+// add data range to region list
+void ihx_add_region(IHX* ihx, size_t address, size_t sz);
+
 // format output as Intel HEX file
+// note: image must lie below 4 GB
 // if filler <= 255 then may skip consecutive "filler" bytes
 // if wrap == 0 then use default value (16)
-void ihx_dump(IHX* ihx, unsigned filler, unsigned wrap, FILE* f);
+// if page > 0 then records never cross page boundary and blank pages are skipped
+// if ref != NULL then only pages (or records) whose loaded data differs from ref
+// are written in full
+void ihx_dump(IHX* ihx, const IHX* ref, unsigned filler, unsigned wrap, unsigned page,
+    FILE* f);
+
+// format output as Motorola S-record file
+// same options as ihx_dump()
+void srec_dump(IHX* ihx, const IHX* ref, unsigned filler, unsigned wrap, unsigned page,
+    FILE* f);
 
 #if defined(__cplusplus)
 }
@@ -0,0 +1,124 @@
+#include "lz4.h"
+#include "stdz.h"
+
+#define MINMATCH        4
+#define LASTLITERALS    5   // last bytes are always literals
+#define MFLIMIT         12  // last match must start before this
+#define MAX_OFFSET      0xffff
+#define HASH_LOG        16
+
+static uint32_t read32(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static unsigned hash32(uint32_t seq)
+{
+    return (seq * 2654435761u) >> (32 - HASH_LOG);
+}
+
+// write extra length bytes
+static uint8_t* put_length(uint8_t* dst, size_t length)
+{
+    for (; length >= 255; length -= 255)
+        *dst++ = 255;
+    *dst++ = (uint8_t)length;
+    return dst;
+}
+
+// write one sequence: literals followed by optional match
+static uint8_t* put_sequence(uint8_t* dst, const uint8_t* literals, size_t nlit,
+    size_t offset, size_t match)
+{
+    uint8_t* token = dst++;
+    *token = (uint8_t)(min(nlit, 15) << 4);
+    if (nlit >= 15)
+        dst = put_length(dst, nlit - 15);
+    if (nlit > 0)   // literals may be NULL for empty input
+        memcpy(dst, literals, nlit);
+    dst += nlit;
+
+    if (match > 0) {
+        *dst++ = (uint8_t)offset;
+        *dst++ = (uint8_t)(offset >> 8);
+        match -= MINMATCH;
+        *token |= (uint8_t)min(match, 15);
+        if (match >= 15)
+            dst = put_length(dst, match - 15);
+    }
+    return dst;
+}
+
+size_t lz4_bound(size_t n)
+{
+    return n + n / 255 + 16;
+}
+
+size_t lz4_compress(const uint8_t* src, size_t n, uint8_t* dst)
+{
+    uint8_t* out = dst;
+    size_t anchor = 0;
+
+    if (n > MFLIMIT) {
+        // positions + 1, zero means empty slot
+        size_t* table = (size_t*)calloc(1 << HASH_LOG, sizeof(size_t));
+        if (table == NULL)
+            z_error(EXIT_FAILURE, errno, "calloc(%u)", 1 << HASH_LOG);
+
+        for (size_t i = 0; i < n - MFLIMIT; ) {
+            uint32_t seq = read32(src + i);
+            unsigned h = hash32(seq);
+            size_t ref = table[h] - 1;
+            table[h] = i + 1;
+
+            if (ref == SIZE_MAX || i - ref > MAX_OFFSET || read32(src + ref) != seq) {
+                ++i;
+                continue;
+            }
+
+            // extend match
+            size_t match = MINMATCH, limit = n - LASTLITERALS - i;
+            while (match < limit && src[ref + match] == src[i + match])
+                ++match;
+
+            out = put_sequence(out, src + anchor, i - anchor, i - ref, match);
+            i += match;
+            anchor = i;
+        }
+        free(table);
+    }
+
+    // last literals
+    out = put_sequence(out, src + anchor, n - anchor, 0, 0);
+    return out - dst;
+}
+
+void lz4_decoder(const char* name, FILE* f)
+{
+    fprintf(f,
+"static unsigned long %s(unsigned char* dst, const unsigned char* src,\n"
+"    unsigned long n)\n"
+"{\n"
+"    unsigned char* out = dst;\n"
+"    const unsigned char* end = src + n;\n"
+"    while (src < end) {\n"
+"        unsigned token = *src++;\n"
+"        unsigned long length = token >> 4, offset;\n"
+"        unsigned char c;\n"
+"        if (length == 15)\n"
+"            do length += c = *src++; while (c == 255);\n"
+"        while (length-- > 0)\n"
+"            *out++ = *src++;\n"
+"        if (src >= end)\n"
+"            break;\n"
+"        offset = src[0] | ((unsigned long)src[1] << 8);\n"
+"        src += 2;\n"
+"        length = token & 15;\n"
+"        if (length == 15)\n"
+"            do length += c = *src++; while (c == 255);\n"
+"        for (length += 4; length-- > 0; ++out)\n"
+"            *out = out[-(long)offset];\n"
+"    }\n"
+"    return (unsigned long)(out - dst);\n"
+"}\n", name);
+}
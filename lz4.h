@@ -0,0 +1,30 @@
+#if !defined(LZ4_H)
+#define LZ4_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// maximum compressed size for n input bytes
+size_t lz4_bound(size_t n);
+
+// compress n bytes into LZ4 block format
+// dst must hold at least lz4_bound(n) bytes
+// return compressed size
+size_t lz4_compress(const uint8_t* src, size_t n, uint8_t* dst);
+
+// write C99 source of freestanding decoder function
+// static unsigned long name(unsigned char* dst, const unsigned char* src,
+//     unsigned long n);
+// returns decompressed size
+void lz4_decoder(const char* name, FILE* f);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // LZ4_H
@@ -0,0 +1,30 @@
+#if !defined(SHA256_H)
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#define SHA256_SIZE 32
+
+typedef struct {
+    uint32_t state[8];
+    uint64_t count;     // bytes processed
+    uint8_t block[64];
+} SHA256_CTX;
+
+void sha256_init(SHA256_CTX* ctx);
+void sha256_update(SHA256_CTX* ctx, const void* data, size_t n);
+void sha256_final(SHA256_CTX* ctx, uint8_t digest[SHA256_SIZE]);
+
+// hash n bytes at once
+void sha256(const void* data, size_t n, uint8_t digest[SHA256_SIZE]);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif // SHA256_H
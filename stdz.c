@@ -2,7 +2,7 @@
 #if defined(_WIN32)
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
-#elif defined(__unix__)
+#elif defined(__unix__) || defined(__APPLE__)
 #include <sys/select.h>
 #endif
 
@@ -275,7 +275,7 @@ void z_delay(uint32_t ms)
 {
 #if defined(_WIN32)
     Sleep(ms);
-#elif defined(__unix__)
+#elif defined(__unix__) || defined(__APPLE__)
     select(0, NULL, NULL, NULL, &(struct timeval){ .tv_sec = ms / 1000,
         .tv_usec = (ms % 1000) * 1000 });
 #endif